@@ -1,7 +1,18 @@
 #include "ljson.h"
 #include <string.h> /* memset, memcpy, memcmp */
 #include <stdio.h> /* _snprintf */
-#include <math.h> /* pow */
+#include <stdlib.h> /* strtod */
+#include <math.h> /* signbit */
+#include <locale.h> /* localeconv */
+
+#if defined(__AVX2__)
+#include <immintrin.h> /* _mm256_xxx */
+#define LJSON_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h> /* _mm_xxx */
+#define LJSON_SSE2
+#endif
 
 #define LJSON_AWAIT_KEY         0x00    /* '"', '}', pop LJSON_IN_KEY */
 #define LJSON_IN_KEY            0x01    /* push LJSON_IN_KEY */
@@ -14,6 +25,11 @@
 #define LJSON_AWAIT_COMMA       0x08    /* '}', ']', ',' */
 #define LJSON_IN_STRING         0x09    /* '"', '\\', pop LJSON_IN_KEY, pop LJSON_IN_VAL_STRING */
 #define LJSON_IN_STR_ESCAPE     0x0A    /* \b \f \n \r \t \u1234 */
+#define LJSON_IN_RAW            0x0B    /* '{', '[', '"', '}', ']' */
+#define LJSON_IN_RAW_STRING     0x0C    /* '"', '\\' */
+#define LJSON_IN_RAW_ESCAPE     0x0D
+#define LJSON_IN_RAW_TOKEN      0x0E    /* '}', ']', ',' */
+#define LJSON_IN_VAL_RAW_ARRAY  0x0F    /* push LJSON_IN_VAL_RAW_ARRAY, items as text after LJSON_ERROR_RAW at '[' */
 
 #define lowcase(ch) ((((ch) >= 'A') && ((ch) <= 'Z')) ? ((ch) + 'a' - 'A') : (ch))
 
@@ -169,7 +185,8 @@ uint8_t str_to_num(const char *str, void *num, uint8_t size, uint8_t width)
     }
     if (neg)
     {
-        n_tmp = -(int64_t)n_tmp;
+        /* in two's complement, no overflow for the least int64_t */
+        n_tmp = 0 - n_tmp;
     }
 
     numcpy(num, n_tmp, size);
@@ -177,45 +194,86 @@ uint8_t str_to_num(const char *str, void *num, uint8_t size, uint8_t width)
     return str - str_tmp;
 }
 
-uint8_t str_to_real(const char *str, void *num, uint8_t size)
+/* number at str with a fraction, and an exponent if exp, correctly rounded by strtod on a copy of it alone */
+static uint8_t _str_to_double(const char *str, double *real, uint8_t exp)
 {
-    double r_tmp = 0;
-    int64_t n_tmp = 0;
-    const char *str_tmp = str;
+    char copy[0x100 + 8]; /* the length is a uint8_t, and the decimal point of LC_NUMERIC */
+    const char *point;
+    uint16_t n = 0;
+    uint16_t i;
+    uint16_t j = 0;
+    uint8_t k;
 
-    str += str_to_num(str, &n_tmp, sizeof(n_tmp), 0);
-    if (*str == '.')
+    if ((str[n] == '+') || (str[n] == '-'))
+    {
+        n++;
+    }
+    while ((str[n] >= '0') && (str[n] <= '9'))
+    {
+        n++;
+    }
+    if (str[n] == '.')
+    {
+        n++;
+        while ((str[n] >= '0') && (str[n] <= '9'))
+        {
+            n++;
+        }
+    }
+    if (exp && ((str[n] == 'e') || (str[n] == 'E')))
+    {
+        n++;
+        if ((str[n] == '+') || (str[n] == '-'))
+        {
+            n++;
+        }
+        while ((str[n] >= '0') && (str[n] <= '9'))
+        {
+            n++;
+        }
+    }
+    if (n >= sizeof(copy))
     {
-        uint64_t f_tmp;
-        uint8_t f = str_to_num(++str, &f_tmp, sizeof(n_tmp), 0);
-        str += f;
-        r_tmp = (double)f_tmp / pow(10, f);
+        n = sizeof(copy) - 1;
+    }
+    /* no "inf", "nan", hex or trailing text for strtod, and its decimal point for '.' */
+    point = localeconv()->decimal_point;
+    for (i = 0; i < n; i++)
+    {
+        if (str[i] != '.')
+        {
+            copy[j++] = str[i];
+            continue;
+        }
+        for (k = 0; (k < 8) && (point[k] != '\0'); k++)
+        {
+            copy[j++] = point[k];
+        }
     }
-    r_tmp += n_tmp;
+    copy[j] = '\0';
+    *real = strtod(copy, 0);
+
+    return (uint8_t)n;
+}
+
+uint8_t str_to_real(const char *str, void *num, uint8_t size)
+{
+    double r_tmp;
+    uint8_t n = _str_to_double(str, &r_tmp, 0);
 
     realcpy(num, r_tmp, size);
 
-    return str - str_tmp;
+    return n;
 }
 
 uint8_t str_to_exp(const char *str, void *num, uint8_t size)
 {
-    double r_tmp = 1;
-    double n_tmp = 0;
-    const char *str_tmp = str;
-
-    str += str_to_real(str, &n_tmp, sizeof(n_tmp));
-    if ((*str == 'e') || (*str == 'E'))
-    {
-        double f_tmp;
-        str += str_to_real(++str, &f_tmp, sizeof(n_tmp));
-        r_tmp = pow(10, f_tmp);
-    }
-    r_tmp *= n_tmp;
+    double r_tmp;
+    uint8_t n = _str_to_double(str, &r_tmp, 1);
 
     realcpy(num, r_tmp, size);
 
-    return str - str_tmp;
+    return n;
 }
 
 static uint8_t _lowcase_cmp(const char *s1, const char *s2)
@@ -266,7 +324,7 @@ uint16_t snprintf_tab(char *dst, uint16_t size, uint16_t count)
         dst += 4;
     }
 
-    if (eod >= dst_tmp)
+    if (size > 0)
     {
         if (dst <= eod) *dst = '\0';
         else *eod = '\0';
@@ -277,96 +335,16 @@ uint16_t snprintf_tab(char *dst, uint16_t size, uint16_t count)
 
 uint16_t snprintf_string(char *dst, uint16_t size, const void *src, uint16_t length)
 {
-    char *dst_tmp = dst;
-    char *eod = dst + size - 1;
-    const char *cp = (const char *)src;
-
-    if (!length)
-    {
-        length--;
-    }
+    ljson_writer_t writer;
 
-    if (*cp)
-    {
-        if (dst < eod) *dst = '"';
-        dst++;
-        for (; *cp && length--; cp++)
-        {
-            if (((uint8_t)(*cp) >= 0x20) && ((uint8_t)(*cp) != 0x7F) && (*cp != '\"') && (*cp != '\\'))
-            {
-                if (dst < eod) *dst = *cp;
-                dst++;
-            }
-            else
-            {
-                if (dst < eod) *dst = '\\';
-                dst++;
-                switch (*cp)
-                {
-                case '\\':
-                    if (dst < eod) *dst = '\\';
-                    dst++;
-                    break;
-                case '\"':
-                    if (dst < eod) *dst = '"';
-                    dst++;
-                    break;
-                case '\b':
-                    if (dst < eod) *dst = 'b';
-                    dst++;
-                    break;
-                case '\f':
-                    if (dst < eod) *dst = 'f';
-                    dst++;
-                    break;
-                case '\r':
-                    if (dst < eod) *dst = 'r';
-                    dst++;
-                    break;
-                case '\n':
-                    if (dst < eod) *dst = 'n';
-                    dst++;
-                    break;
-                case '\t':
-                    if (dst < eod) *dst = 't';
-                    dst++;
-                    break;
-                default:
-                    if (dst + (5 - 1) < eod)
-                    {
-                        _snprintf(dst, (5 + 1), "u%04x", (uint8_t)*cp);
-                    }
-                    else if (dst < eod)
-                    {
-                        *dst = '\0';
-                    }
-                    dst += 5;
-                    break;
-                }
-            }
-        }
-        if (dst < eod) *dst = '"';
-        dst++;
-    }
-    else
-    {
-        if (dst + (4 - 1) < eod)
-        {
-            _snprintf(dst, (4 + 1), "null");
-        }
-        else if (dst < eod)
-        {
-            *dst = '\0';
-        }
-        dst += 4;
-    }
-    if (eod >= dst_tmp)
+    ljson_writer_init(&writer, dst, (size > 0) ? (size - 1) : 0, 0, 0);
+    ljson_writer_string(&writer, src, length);
+    if (size > 0)
     {
-        if (dst <= eod) *dst = '\0';
-        else *eod = '\0';
+        dst[writer.used] = '\0';
     }
 
-    return dst - dst_tmp;
+    return (uint16_t)writer.length;
 }
 
 uint16_t snprintf_token(char *dst, uint16_t size, const void *src)
@@ -382,567 +360,2931 @@ uint16_t snprintf_token(char *dst, uint16_t size, const void *src)
     return res;
 }
 
+/* "00" .. "99" */
+static const char _ljson_digits[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* decimal digits of value, ending at end, returns the first */
+static char *_ljson_utoa(char *end, uint64_t value)
+{
+    char *cp = end;
+
+    while (value >= 100)
+    {
+        cp -= 2;
+        memcpy(cp, &_ljson_digits[(value % 100) * 2], 2);
+        value /= 100;
+    }
+    if (value >= 10)
+    {
+        cp -= 2;
+        memcpy(cp, &_ljson_digits[value * 2], 2);
+    }
+    else
+    {
+        *--cp = (char)('0' + value);
+    }
+
+    return cp;
+}
+
 uint16_t snprintf_integer(char *dst, uint16_t size, const void *src, uint16_t length)
 {
-    uint16_t res = 0;
+    char number[24];
+    char *cp;
+    int64_t value;
 
     switch (length)
     {
     case sizeof(int8_t) :
-        res = _snprintf(dst, size, "%d", *(int8_t*)src);
+        value = *(int8_t*)src;
         break;
     case sizeof(int16_t) :
-        res = _snprintf(dst, size, "%d", *(int16_t*)src);
+        value = *(int16_t*)src;
         break;
     case sizeof(int32_t) :
-        res = _snprintf(dst, size, "%d", *(int32_t*)src);
+        value = *(int32_t*)src;
         break;
     case sizeof(int64_t) :
-        res = _snprintf(dst, size, "%ld", *(int64_t*)src);
+        value = *(int64_t*)src;
         break;
+    default:
+        return 0;
     }
 
-    if ((res >= size) && ((dst != 0) || (size != 0)))
+    cp = _ljson_utoa(number + sizeof(number), (value < 0) ? (0 - (uint64_t)value) : (uint64_t)value);
+    if (value < 0)
     {
-        if (size > 0) *dst = '\0';
-        return snprintf_integer(0, 0, src, length);
+        *--cp = '-';
     }
 
-    return res;
+    return snprintf_raw(dst, size, cp, (uint16_t)(number + sizeof(number) - cp));
 }
 
-uint16_t snprintf_real(char *dst, uint16_t size, const void *src, uint16_t length)
+uint16_t snprintf_unsigned(char *dst, uint16_t size, const void *src, uint16_t length)
 {
-    uint16_t res = 0;
+    char number[24];
+    char *cp;
+    uint64_t value;
 
     switch (length)
     {
-    case sizeof(float) :
-        res = _snprintf(dst, size, "%g", *(float*)src);
+    case sizeof(uint8_t) :
+        value = *(uint8_t*)src;
         break;
-    case sizeof(double) :
-        res = _snprintf(dst, size, "%g", *(double*)src);
+    case sizeof(uint16_t) :
+        value = *(uint16_t*)src;
+        break;
+    case sizeof(uint32_t) :
+        value = *(uint32_t*)src;
         break;
+    case sizeof(uint64_t) :
+        value = *(uint64_t*)src;
+        break;
+    default:
+        return 0;
     }
 
-    if ((res >= size) && ((dst != 0) || (size != 0)))
-    {
-        if (size > 0) *dst = '\0';
-        return snprintf_real(0, 0, src, length);
-    }
+    cp = _ljson_utoa(number + sizeof(number), value);
 
-    return res;
+    return snprintf_raw(dst, size, cp, (uint16_t)(number + sizeof(number) - cp));
 }
 
-////////////////////////////////////////////////////////////////////////////////
+/* Grisu2 (Loitsch, "Printing floating-point numbers quickly and accurately"),
+ * digits that read back to the same value, shortest but for rare cases */
 
-void ljson_contex_init(ljson_contex_t *contex, const ljson_item_t *top)
+typedef struct _ljson_fp
 {
-    memset(contex, 0, sizeof(ljson_contex_t));
+    uint64_t f;
+    int32_t e;
+} ljson_fp_t;
+
+typedef struct _ljson_pow10
+{
+    uint64_t f;
+    int16_t e;
+    int16_t k;
+} ljson_pow10_t;
 
-    contex->ljson_item = (ljson_item_t *)top;
-    lstack_init(&contex->stack, contex->stack_buffer, LJSON_CONTEX_STACK_SIZE);
+/* 10^k normalized, k = -300, -292 .. 324 */
+static const ljson_pow10_t _ljson_pow10[] =
+{
+    { 0xAB70FE17C79AC6CAULL, -1060, -300 }, { 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+    { 0xBE5691EF416BD60CULL, -1007, -284 }, { 0x8DD01FAD907FFC3CULL, -980, -276 },
+    { 0xD3515C2831559A83ULL, -954, -268 }, { 0x9D71AC8FADA6C9B5ULL, -927, -260 },
+    { 0xEA9C227723EE8BCBULL, -901, -252 }, { 0xAECC49914078536DULL, -874, -244 },
+    { 0x823C12795DB6CE57ULL, -847, -236 }, { 0xC21094364DFB5637ULL, -821, -228 },
+    { 0x9096EA6F3848984FULL, -794, -220 }, { 0xD77485CB25823AC7ULL, -768, -212 },
+    { 0xA086CFCD97BF97F4ULL, -741, -204 }, { 0xEF340A98172AACE5ULL, -715, -196 },
+    { 0xB23867FB2A35B28EULL, -688, -188 }, { 0x84C8D4DFD2C63F3BULL, -661, -180 },
+    { 0xC5DD44271AD3CDBAULL, -635, -172 }, { 0x936B9FCEBB25C996ULL, -608, -164 },
+    { 0xDBAC6C247D62A584ULL, -582, -156 }, { 0xA3AB66580D5FDAF6ULL, -555, -148 },
+    { 0xF3E2F893DEC3F126ULL, -529, -140 }, { 0xB5B5ADA8AAFF80B8ULL, -502, -132 },
+    { 0x87625F056C7C4A8BULL, -475, -124 }, { 0xC9BCFF6034C13053ULL, -449, -116 },
+    { 0x964E858C91BA2655ULL, -422, -108 }, { 0xDFF9772470297EBDULL, -396, -100 },
+    { 0xA6DFBD9FB8E5B88FULL, -369, -92 }, { 0xF8A95FCF88747D94ULL, -343, -84 },
+    { 0xB94470938FA89BCFULL, -316, -76 }, { 0x8A08F0F8BF0F156BULL, -289, -68 },
+    { 0xCDB02555653131B6ULL, -263, -60 }, { 0x993FE2C6D07B7FACULL, -236, -52 },
+    { 0xE45C10C42A2B3B06ULL, -210, -44 }, { 0xAA242499697392D3ULL, -183, -36 },
+    { 0xFD87B5F28300CA0EULL, -157, -28 }, { 0xBCE5086492111AEBULL, -130, -20 },
+    { 0x8CBCCC096F5088CCULL, -103, -12 }, { 0xD1B71758E219652CULL, -77, -4 },
+    { 0x9C40000000000000ULL, -50, 4 }, { 0xE8D4A51000000000ULL, -24, 12 },
+    { 0xAD78EBC5AC620000ULL, 3, 20 }, { 0x813F3978F8940984ULL, 30, 28 },
+    { 0xC097CE7BC90715B3ULL, 56, 36 }, { 0x8F7E32CE7BEA5C70ULL, 83, 44 },
+    { 0xD5D238A4ABE98068ULL, 109, 52 }, { 0x9F4F2726179A2245ULL, 136, 60 },
+    { 0xED63A231D4C4FB27ULL, 162, 68 }, { 0xB0DE65388CC8ADA8ULL, 189, 76 },
+    { 0x83C7088E1AAB65DBULL, 216, 84 }, { 0xC45D1DF942711D9AULL, 242, 92 },
+    { 0x924D692CA61BE758ULL, 269, 100 }, { 0xDA01EE641A708DEAULL, 295, 108 },
+    { 0xA26DA3999AEF774AULL, 322, 116 }, { 0xF209787BB47D6B85ULL, 348, 124 },
+    { 0xB454E4A179DD1877ULL, 375, 132 }, { 0x865B86925B9BC5C2ULL, 402, 140 },
+    { 0xC83553C5C8965D3DULL, 428, 148 }, { 0x952AB45CFA97A0B3ULL, 455, 156 },
+    { 0xDE469FBD99A05FE3ULL, 481, 164 }, { 0xA59BC234DB398C25ULL, 508, 172 },
+    { 0xF6C69A72A3989F5CULL, 534, 180 }, { 0xB7DCBF5354E9BECEULL, 561, 188 },
+    { 0x88FCF317F22241E2ULL, 588, 196 }, { 0xCC20CE9BD35C78A5ULL, 614, 204 },
+    { 0x98165AF37B2153DFULL, 641, 212 }, { 0xE2A0B5DC971F303AULL, 667, 220 },
+    { 0xA8D9D1535CE3B396ULL, 694, 228 }, { 0xFB9B7CD9A4A7443CULL, 720, 236 },
+    { 0xBB764C4CA7A44410ULL, 747, 244 }, { 0x8BAB8EEFB6409C1AULL, 774, 252 },
+    { 0xD01FEF10A657842CULL, 800, 260 }, { 0x9B10A4E5E9913129ULL, 827, 268 },
+    { 0xE7109BFBA19C0C9DULL, 853, 276 }, { 0xAC2820D9623BF429ULL, 880, 284 },
+    { 0x80444B5E7AA7CF85ULL, 907, 292 }, { 0xBF21E44003ACDD2DULL, 933, 300 },
+    { 0x8E679C2F5E44FF8FULL, 960, 308 }, { 0xD433179D9C8CB841ULL, 986, 316 },
+    { 0x9E19DB92B4E31BA9ULL, 1013, 324 }};
+
+static ljson_fp_t _ljson_fp_mul(ljson_fp_t x, ljson_fp_t y)
+{
+    uint64_t p0 = (x.f & 0xFFFFFFFF) * (y.f & 0xFFFFFFFF);
+    uint64_t p1 = (x.f & 0xFFFFFFFF) * (y.f >> 32);
+    uint64_t p2 = (x.f >> 32) * (y.f & 0xFFFFFFFF);
+    uint64_t p3 = (x.f >> 32) * (y.f >> 32);
+    uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFF) + (p2 & 0xFFFFFFFF) + (1ULL << 31);
+    ljson_fp_t r;
+
+    /* upper 64 bits, rounded */
+    r.f = p3 + (p1 >> 32) + (p2 >> 32) + (q >> 32);
+    r.e = x.e + y.e + 64;
+
+    return r;
 }
 
-uint8_t ljson_contex_push(ljson_contex_t *contex, uint8_t type)
+static ljson_fp_t _ljson_fp_normalize(ljson_fp_t x)
 {
-    if (contex->ljson_item == 0)
+    while ((x.f >> 63) == 0)
     {
-        contex->ljson_item_miss++;
-        return LJSON_ERROR_NONE;
+        x.f <<= 1;
+        x.e--;
     }
-    switch (type)
+
+    return x;
+}
+
+static void _ljson_grisu_round(char *buffer, uint8_t length, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t ten_k)
+{
+    while ((rest < dist) && (delta - rest >= ten_k) && ((rest + ten_k < dist) || (dist - rest > rest + ten_k - dist)))
     {
-    case LJSON_TYPE_OBJECT_L:
-        if (contex->ljson_item->type != LJSON_ITEM_OBJECT)
+        buffer[length - 1]--;
+        rest += ten_k;
+    }
+}
+
+/* digits of value > 0, value = digits * 10^exponent */
+static uint8_t _ljson_grisu(char *buffer, int16_t *exponent, double value, uint8_t single)
+{
+    ljson_fp_t v;
+    ljson_fp_t m_minus;
+    ljson_fp_t m_plus;
+    ljson_fp_t w;
+    ljson_fp_t c;
+    const ljson_pow10_t *cached;
+    uint64_t bits;
+    uint64_t hidden;
+    uint64_t delta;
+    uint64_t dist;
+    uint64_t rest;
+    uint64_t p2;
+    uint64_t one;
+    uint32_t p1;
+    uint32_t pow10;
+    uint32_t bits_single;
+    float value_single;
+    int32_t e;
+    int32_t bias;
+    int32_t k;
+    uint8_t shift;
+    uint8_t length = 0;
+    uint8_t n;
+
+    if (single)
+    {
+        value_single = (float)value;
+        memcpy(&bits_single, &value_single, sizeof(bits_single));
+        bits = bits_single;
+        e = (int32_t)(bits >> 23);
+        hidden = 1ULL << 23;
+        bias = 127 + 23;
+    }
+    else
+    {
+        memcpy(&bits, &value, sizeof(bits));
+        e = (int32_t)(bits >> 52);
+        hidden = 1ULL << 52;
+        bias = 1023 + 52;
+    }
+    bits &= hidden - 1;
+    v.f = (e == 0) ? bits : (bits + hidden);
+    v.e = (e == 0) ? (1 - bias) : (e - bias);
+
+    /* boundaries halfway to the neighbours */
+    m_plus.f = 2 * v.f + 1;
+    m_plus.e = v.e - 1;
+    if ((bits == 0) && (e > 1))
+    {
+        m_minus.f = 4 * v.f - 1;
+        m_minus.e = v.e - 2;
+    }
+    else
+    {
+        m_minus.f = 2 * v.f - 1;
+        m_minus.e = v.e - 1;
+    }
+    m_plus = _ljson_fp_normalize(m_plus);
+    m_minus.f <<= m_minus.e - m_plus.e;
+    m_minus.e = m_plus.e;
+    v = _ljson_fp_normalize(v);
+
+    /* cached power that brings the exponent into [-60, -32] */
+    k = -60 - m_plus.e - 1;
+    k = (k * 78913) / (1 << 18) + (k > 0);
+    cached = &_ljson_pow10[(300 + k + 7) / 8];
+    c.f = cached->f;
+    c.e = cached->e;
+    w = _ljson_fp_mul(v, c);
+    m_minus = _ljson_fp_mul(m_minus, c);
+    m_plus = _ljson_fp_mul(m_plus, c);
+    m_minus.f++;
+    m_plus.f--;
+    *exponent = -cached->k;
+
+    delta = m_plus.f - m_minus.f;
+    dist = m_plus.f - w.f;
+    shift = (uint8_t)-m_plus.e;
+    one = 1ULL << shift;
+    p1 = (uint32_t)(m_plus.f >> shift);
+    p2 = m_plus.f & (one - 1);
+
+    for (n = 1, pow10 = 1; (n < 10) && (p1 >= pow10 * 10); n++)
+    {
+        pow10 *= 10;
+    }
+    while (n > 0)
+    {
+        buffer[length++] = (char)('0' + p1 / pow10);
+        p1 %= pow10;
+        n--;
+        rest = ((uint64_t)p1 << shift) + p2;
+        if (rest <= delta)
         {
-            return LJSON_ERROR_OBJECT_L;
+            *exponent += n;
+            _ljson_grisu_round(buffer, length, dist, delta, rest, (uint64_t)pow10 << shift);
+            return length;
         }
-        break;
-    case LJSON_TYPE_ARRAY_L:
-        if (contex->ljson_item->type != LJSON_ITEM_ARRAY)
+        pow10 /= 10;
+    }
+    while (1)
+    {
+        p2 *= 10;
+        buffer[length++] = (char)('0' + (p2 >> shift));
+        p2 &= one - 1;
+        delta *= 10;
+        dist *= 10;
+        (*exponent)--;
+        if (p2 <= delta)
         {
-            return LJSON_ERROR_ARRAY_L;
+            break;
         }
-        break;
-    default:
-        break;
     }
-    if (!lstack_is_empty(&contex->stack))
+    _ljson_grisu_round(buffer, length, dist, delta, p2, one);
+
+    return length;
+}
+
+/* shortest text of value, plain from 1e-6 up to 1e21, else with exponent */
+static uint8_t _ljson_dtoa(char *buffer, double value, uint8_t single)
+{
+    char digits[20];
+    char *cp = buffer;
+    char *end;
+    int16_t exponent;
+    int16_t point;
+    uint8_t length;
+
+    if ((value != value) || (value - value != 0))
+    {
+        /* nan, inf */
+        memcpy(buffer, "null", 4);
+        return 4;
+    }
+    if (signbit(value))
+    {
+        *cp++ = '-';
+        value = -value;
+    }
+    if (value == 0)
     {
-        ljson_item_t *item_top;
+        *cp++ = '0';
+        return (uint8_t)(cp - buffer);
+    }
 
-        lstack_top_buffer(&contex->stack, &item_top, sizeof(item_top));
-        if ((item_top->type == LJSON_ITEM_ARRAY) && (item_top->length > 0) && (contex->ljson_item_index >= item_top->length))
+    length = _ljson_grisu(digits, &exponent, value, single);
+    point = length + exponent;
+    if ((length <= point) && (point <= 21))
+    {
+        /* 1234000 */
+        memcpy(cp, digits, length);
+        memset(cp + length, '0', point - length);
+        cp += point;
+    }
+    else if ((0 < point) && (point <= 21))
+    {
+        /* 12.34 */
+        memcpy(cp, digits, point);
+        cp[point] = '.';
+        memcpy(cp + point + 1, digits + point, length - point);
+        cp += length + 1;
+    }
+    else if ((-6 < point) && (point <= 0))
+    {
+        /* 0.001234 */
+        *cp++ = '0';
+        *cp++ = '.';
+        memset(cp, '0', -point);
+        cp += -point;
+        memcpy(cp, digits, length);
+        cp += length;
+    }
+    else
+    {
+        /* 1.234e-7 */
+        *cp++ = digits[0];
+        if (length > 1)
         {
-#ifdef LJSON_ERROR_ARRAY_OVER_IGNORE
-            contex->ljson_item = 0;
-            contex->ljson_item_miss++;
-            return LJSON_ERROR_NONE;
-#else
-            return LJSON_ERROR_ARRAY_OVER;
-#endif
+            *cp++ = '.';
+            memcpy(cp, digits + 1, length - 1);
+            cp += length - 1;
         }
+        *cp++ = 'e';
+        *cp++ = (point - 1 < 0) ? '-' : '+';
+        point = (point - 1 < 0) ? (1 - point) : (point - 1);
+        /* digits are written out, reuse them */
+        end = _ljson_utoa(digits + sizeof(digits), (uint64_t)point);
+        memcpy(cp, end, digits + sizeof(digits) - end);
+        cp += digits + sizeof(digits) - end;
     }
-    if (lstack_free(&contex->stack) < SIZE_OF_STACK_CONTEX)
+
+    return (uint8_t)(cp - buffer);
+}
+
+uint16_t snprintf_real(char *dst, uint16_t size, const void *src, uint16_t length)
+{
+    char number[32];
+    uint8_t res;
+
+    switch (length)
     {
-        return LJSON_ERROR_STACK_OVER;
+    case sizeof(float) :
+        res = _ljson_dtoa(number, *(float*)src, 1);
+        break;
+    case sizeof(double) :
+        res = _ljson_dtoa(number, *(double*)src, 0);
+        break;
+    default:
+        return 0;
     }
-    lstack_push_buffer(&contex->stack, &contex->ljson_array_offset, sizeof(contex->ljson_array_offset));
-    lstack_push_buffer(&contex->stack, &contex->ljson_item_index, sizeof(contex->ljson_item_index));
-    lstack_push_buffer(&contex->stack, &contex->ljson_item, sizeof(contex->ljson_item));
-
-    contex->ljson_item_index = 0;
 
-    return LJSON_ERROR_NONE;
+    return snprintf_raw(dst, size, number, res);
 }
 
-uint8_t ljson_contex_pop(ljson_contex_t *contex, uint8_t type)
+uint16_t snprintf_raw(char *dst, uint16_t size, const void *src, uint16_t length)
 {
-    if (contex->ljson_item_miss > 0)
+    if (length < size)
     {
-        contex->ljson_item_miss--;
-        return LJSON_ERROR_NONE;
+        memcpy(dst, src, length);
+        dst[length] = '\0';
     }
-    lstack_pop_buffer(&contex->stack, &contex->ljson_item, sizeof(contex->ljson_item));
-    lstack_pop_buffer(&contex->stack, &contex->ljson_item_index, sizeof(contex->ljson_item_index));
-    lstack_pop_buffer(&contex->stack, &contex->ljson_array_offset, sizeof(contex->ljson_array_offset));
-    if (!lstack_is_empty(&contex->stack))
+    else if (size > 0)
     {
-        ljson_item_t *item_top;
+        *dst = '\0';
+    }
 
-        contex->ljson_item_index++;
-        lstack_top_buffer(&contex->stack, &item_top, sizeof(item_top));
-        if (item_top->type == LJSON_ITEM_ARRAY)
+    return length;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ljson_writer_init(ljson_writer_t *writer, void *buffer, uint16_t size, ljson_flush_t flush, void *user)
+{
+    memset(writer, 0, sizeof(ljson_writer_t));
+
+    writer->buffer = (char *)buffer;
+    writer->size = size;
+    writer->flush = flush;
+    writer->user = user;
+}
+
+/* pieces into iov, each flush one call of flushv: text from ljson_writer_reference kept in place, the rest in the block */
+void ljson_writer_iovec(ljson_writer_t *writer, ljson_iovec_t *iov, uint16_t size, ljson_flushv_t flushv)
+{
+    writer->iov = iov;
+    writer->iov_size = size;
+    writer->iov_count = 0;
+    writer->flushv = flushv;
+}
+
+/* the block, or the pieces with ljson_writer_iovec, to the sink: 0 if there is none */
+static uint8_t _ljson_writer_drain(ljson_writer_t *writer)
+{
+    if (writer->iov != 0)
+    {
+        if (writer->flushv == 0)
+        {
+            /* pieces cannot be only counted */
+            writer->error = LJSON_ERROR_BUFFER_OVER;
+            return 0;
+        }
+        writer->error = writer->flushv(writer->iov, writer->iov_count, writer->user);
+        writer->iov_count = 0;
+    }
+    else
+    {
+        if (writer->flush == 0)
         {
-            contex->ljson_array_offset += item_top->offset;
+            /* counted only */
+            return 0;
         }
+        writer->error = writer->flush(writer->buffer, writer->used, writer->user);
     }
+    writer->used = 0;
 
-    return LJSON_ERROR_NONE;
+    return 1;
 }
 
-uint16_t ljson_contex_snprintf(ljson_contex_t *contex, void *buffer, uint16_t size, uint8_t fmt)
+/* length at src as a piece, joined to the last if right after it: 0 if iov is full */
+static uint8_t _ljson_writer_piece(ljson_writer_t *writer, const void *src, uint32_t length)
 {
-    char *cp = (char *)buffer;
-    char *cp_tmp = cp;
-    char *eob = cp + size;
-
-    uint8_t res;
-    ljson_item_t *item_top;
-    uint8_t *item_buffer;
-    uint8_t level = 0;
+    ljson_iovec_t *iov;
 
-    while (1)
+    if (writer->iov_count > 0)
     {
-        if (!lstack_is_empty(&contex->stack))
+        iov = &writer->iov[writer->iov_count - 1];
+        if ((const char *)iov->iov_base + iov->iov_len == (const char *)src)
         {
-            lstack_top_buffer(&contex->stack, &item_top, sizeof(item_top));
-            if (contex->ljson_item_index >= item_top->length)
-            {
-                if (fmt)
-                {
-                    level--;
-                    if (contex->ljson_item_index > 0)
-                    {
-                        cp += snprintf_token(cp, ((eob > cp) ? (eob - cp) : 0), "\r\n");
-                        cp += snprintf_tab(cp, ((eob > cp) ? (eob - cp) : 0), level);
-                    }
-                }
-                cp += snprintf_token(cp, ((eob > cp) ? (eob - cp) : 0), (item_top->type == LJSON_ITEM_OBJECT) ? "}" : "]");
-                res = ljson_contex_pop(contex, (item_top->type == LJSON_ITEM_OBJECT) ? LJSON_TYPE_OBJECT_R : LJSON_TYPE_ARRAY_R);
-                if (res != LJSON_ERROR_NONE)
-                {
-                    return 0;
-                }
+            iov->iov_len += length;
+            return 1;
+        }
+    }
+    if (writer->iov_count >= writer->iov_size)
+    {
+        return 0;
+    }
+    iov = &writer->iov[writer->iov_count++];
+    iov->iov_base = (void *)src;
+    iov->iov_len = length;
 
-                if (lstack_is_empty(&contex->stack))
-                {
-                    break;
-                }
+    return 1;
+}
 
-                continue;
-            }
-            else
-            {
-                if (item_top->type == LJSON_ITEM_OBJECT)
-                {
-                    contex->ljson_item = &((ljson_item_t *)item_top->buffer)[contex->ljson_item_index];
-                }
-                else /* if (item_top->type == LJSON_ITEM_ARRAY)) */
-                {
-                    contex->ljson_item = (ljson_item_t *)item_top->buffer;
-                }
+uint8_t ljson_writer_write(ljson_writer_t *writer, const void *src, uint32_t length)
+{
+    const char *cp = (const char *)src;
+    uint16_t room;
 
-                if (contex->ljson_item_index > 0)
-                {
-                    cp += snprintf_token(cp, ((eob > cp) ? (eob - cp) : 0), ",");
-                    if (fmt)
-                    {
-                        cp += snprintf_token(cp, ((eob > cp) ? (eob - cp) : 0), "\r\n");
-                    }
-                }
-            }
+    writer->length += length;
+    while ((length > 0) && (writer->error == LJSON_ERROR_NONE))
+    {
+        room = writer->size - writer->used;
+        if (room > length)
+        {
+            room = (uint16_t)length;
         }
-
-        if ((contex->ljson_item->type == LJSON_ITEM_OBJECT) || (contex->ljson_item->type == LJSON_ITEM_ARRAY))
+        if ((room == 0) || ((writer->iov != 0) && !_ljson_writer_piece(writer, writer->buffer + writer->used, room)))
         {
-            if (fmt)
-            {
-                cp += snprintf_tab(cp, ((eob > cp) ? (eob - cp) : 0), level++);
-            }
-            if (contex->ljson_item->name != 0)
-            {
-                cp += snprintf_string(cp, ((eob > cp) ? (eob - cp) : 0), contex->ljson_item->name, 0);
-                cp += snprintf_token(cp, ((eob > cp) ? (eob - cp) : 0), ":");
-            }
-            cp += snprintf_token(cp, ((eob > cp) ? (eob - cp) : 0), (contex->ljson_item->type == LJSON_ITEM_OBJECT) ? "{" : "[");
-            if (fmt)
-            {
-                if (contex->ljson_item->length > 0)
-                {
-                    cp += snprintf_token(cp, ((eob > cp) ? (eob - cp) : 0), "\r\n");
-                }
-            }
-            res = ljson_contex_push(contex, (contex->ljson_item->type == LJSON_ITEM_OBJECT) ? LJSON_TYPE_OBJECT_L : LJSON_TYPE_ARRAY_L);
-            if (res != LJSON_ERROR_NONE)
+            if (!_ljson_writer_drain(writer))
             {
-                return 0;
+                break;
             }
-
             continue;
         }
+        memcpy(writer->buffer + writer->used, cp, room);
+        writer->used += room;
+        cp += room;
+        length -= room;
+    }
+
+    return writer->error;
+}
 
-        if (lstack_is_empty(&contex->stack))
+/* as ljson_writer_write, with ljson_writer_iovec src is not copied and must stay until the flush */
+uint8_t ljson_writer_reference(ljson_writer_t *writer, const void *src, uint32_t length)
+{
+    if ((writer->iov == 0) || (length < LJSON_IOVEC_MIN))
+    {
+        return ljson_writer_write(writer, src, length);
+    }
+
+    writer->length += length;
+    while ((writer->error == LJSON_ERROR_NONE) && !_ljson_writer_piece(writer, src, length))
+    {
+        if (!_ljson_writer_drain(writer))
         {
-            /* error */
-            return 0;
+            break;
         }
+    }
 
-        if (fmt)
+    return writer->error;
+}
+
+/* second char of the escape of each byte, 0 if none */
+static const char _ljson_escape[256] =
+{
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 'u',
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+/* bytes before the first one to escape or '\0', at most length */
+static uint16_t _ljson_clean(const char *src, uint16_t length)
+{
+    const uint8_t *cp = (const uint8_t *)src;
+    const uint8_t *eob = cp + length;
+#if defined(LJSON_AVX2)
+    __m256i v32;
+
+    while (eob - cp >= 32)
+    {
+        v32 = _mm256_loadu_si256((const __m256i *)cp);
+        /* < 0x20 is max(v, 0x1F) == 0x1F */
+        if (_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(v32, _mm256_set1_epi8(0x1F)), _mm256_set1_epi8(0x1F)), _mm256_cmpeq_epi8(v32, _mm256_set1_epi8(0x7F))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v32, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(v32, _mm256_set1_epi8('\\'))))) != 0)
         {
-            cp += snprintf_tab(cp, ((eob > cp) ? (eob - cp) : 0), level);
+            break;
         }
-        lstack_top_buffer(&contex->stack, &item_top, sizeof(item_top));
-        if (item_top->type == LJSON_ITEM_OBJECT)
-        {
-            if (contex->ljson_item->name == 0)
-            {
-                /* error */
-                return 0;
-            }
+        cp += 32;
+    }
+#endif
+#if defined(LJSON_SSE2)
+    __m128i v16;
 
-            cp += snprintf_string(cp, ((eob > cp) ? (eob - cp) : 0), contex->ljson_item->name, 0);
-            cp += snprintf_token(cp, ((eob > cp) ? (eob - cp) : 0), ":");
+    while (eob - cp >= 16)
+    {
+        v16 = _mm_loadu_si128((const __m128i *)cp);
+        if (_mm_movemask_epi8(_mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(v16, _mm_set1_epi8(0x1F)), _mm_set1_epi8(0x1F)), _mm_cmpeq_epi8(v16, _mm_set1_epi8(0x7F))),
+            _mm_or_si128(_mm_cmpeq_epi8(v16, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v16, _mm_set1_epi8('\\'))))) != 0)
+        {
+            break;
         }
+        cp += 16;
+    }
+#endif
+    /* the rest, or the block with the byte to escape */
+    while ((cp < eob) && (_ljson_escape[*cp] == 0))
+    {
+        cp++;
+    }
+
+    return (uint16_t)(cp - (const uint8_t *)src);
+}
+
+/* src whole or not at all when the writer only counts, and nothing after a cut one, as snprintf_string wrote "null" and \u00XX */
+static uint8_t _ljson_writer_whole(ljson_writer_t *writer, const void *src, uint32_t length)
+{
+    if ((writer->flush == 0) && (writer->iov == 0) && ((uint32_t)(writer->size - writer->used) < length))
+    {
+        writer->length += length;
+        writer->size = writer->used;
+        return writer->error;
+    }
+
+    return ljson_writer_write(writer, src, length);
+}
+
+/* as snprintf_string, runs with nothing to escape are written at once, by reference if src is kept */
+static uint8_t _ljson_writer_string(ljson_writer_t *writer, const void *src, uint16_t length, uint8_t keep)
+{
+    const char *cp = (const char *)src;
+    char escape[6];
+    size_t size;
+    uint16_t run;
+
+    if (!*cp)
+    {
+        return _ljson_writer_whole(writer, "null", 4);
+    }
+    if (!length)
+    {
+        /* up to '\0', no reading past it */
+        size = strlen(cp);
+        length = (size > 0xFFFF) ? 0xFFFF : (uint16_t)size;
+    }
 
-        item_buffer = (uint8_t*)contex->ljson_item->buffer;
-        if (contex->ljson_item->type != LJSON_ITEM_CALLBACK)
+    ljson_writer_write(writer, "\"", 1);
+    while (length > 0)
+    {
+        run = _ljson_clean(cp, length);
+        if (keep)
         {
-            item_buffer += contex->ljson_array_offset;
+            ljson_writer_reference(writer, cp, run);
         }
-        switch (contex->ljson_item->type)
+        else
+        {
+            ljson_writer_write(writer, cp, run);
+        }
+        cp += run;
+        length -= run;
+        if ((length == 0) || (*cp == '\0'))
         {
-        case LJSON_ITEM_STRING: /* "chars" null */
-            cp += snprintf_string(cp, ((eob > cp) ? (eob - cp) : 0), item_buffer, contex->ljson_item->length);
             break;
-        case LJSON_ITEM_INTEGER: /* int */
-            cp += snprintf_integer(cp, ((eob > cp) ? (eob - cp) : 0), item_buffer, contex->ljson_item->length);
+        }
+        escape[0] = '\\';
+        escape[1] = _ljson_escape[(uint8_t)*cp];
+        if (escape[1] == 'u')
+        {
+            escape[2] = '0';
+            escape[3] = '0';
+            escape[4] = "0123456789abcdef"[(uint8_t)*cp >> 4];
+            escape[5] = "0123456789abcdef"[(uint8_t)*cp & 0x0F];
+            ljson_writer_write(writer, escape, 1);
+            _ljson_writer_whole(writer, escape + 1, 5);
+        }
+        else
+        {
+            ljson_writer_write(writer, escape, 2);
+        }
+        cp++;
+        length--;
+    }
+
+    return ljson_writer_write(writer, "\"", 1);
+}
+
+uint8_t ljson_writer_string(ljson_writer_t *writer, const void *src, uint16_t length)
+{
+    return _ljson_writer_string(writer, src, length, 0);
+}
+
+uint8_t ljson_writer_integer(ljson_writer_t *writer, int64_t value)
+{
+    char number[24];
+
+    return ljson_writer_write(writer, number, snprintf_integer(number, sizeof(number), &value, sizeof(value)));
+}
+
+uint8_t ljson_writer_real(ljson_writer_t *writer, double value)
+{
+    char number[32];
+
+    return ljson_writer_write(writer, number, snprintf_real(number, sizeof(number), &value, sizeof(value)));
+}
+
+uint8_t ljson_writer_flush(ljson_writer_t *writer)
+{
+    if ((writer->error == LJSON_ERROR_NONE) && (((writer->iov != 0) && (writer->flushv != 0) && (writer->iov_count > 0))
+        || ((writer->iov == 0) && (writer->flush != 0) && (writer->used > 0))))
+    {
+        _ljson_writer_drain(writer);
+    }
+
+    return writer->error;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define LJSON_ARENA_ALIGN(size) (((size) + (sizeof(void *) - 1)) & ~(uint32_t)(sizeof(void *) - 1))
+
+void ljson_arena_init(ljson_arena_t *arena, void *buffer, uint32_t size)
+{
+    memset(arena, 0, sizeof(ljson_arena_t));
+
+    arena->buffer = (uint8_t *)buffer;
+    arena->size = size;
+}
+
+void *ljson_arena_alloc(ljson_arena_t *arena, uint32_t size)
+{
+    uint8_t *buffer;
+
+    size = LJSON_ARENA_ALIGN(size);
+    if (size > arena->size - arena->used)
+    {
+        return 0;
+    }
+    buffer = &arena->buffer[arena->used];
+    arena->used += size;
+
+    return buffer;
+}
+
+/* grow a block from size to length bytes, in place when it is the last one */
+void *ljson_arena_realloc(ljson_arena_t *arena, void *buffer, uint32_t size, uint32_t length)
+{
+    uint8_t *buffer_tmp;
+
+    if ((buffer != 0) && ((uint8_t *)buffer + LJSON_ARENA_ALIGN(size) == &arena->buffer[arena->used]))
+    {
+        if (LJSON_ARENA_ALIGN(length) - LJSON_ARENA_ALIGN(size) > arena->size - arena->used)
+        {
+            return 0;
+        }
+        arena->used += LJSON_ARENA_ALIGN(length) - LJSON_ARENA_ALIGN(size);
+        return buffer;
+    }
+
+    buffer_tmp = (uint8_t *)ljson_arena_alloc(arena, length);
+    if ((buffer_tmp != 0) && (buffer != 0))
+    {
+        memcpy(buffer_tmp, buffer, size);
+    }
+
+    return buffer_tmp;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ljson_hash(const void *buffer, uint16_t length)
+{
+    const uint8_t *cp = (const uint8_t *)buffer;
+    uint32_t hash = LJSON_HASH_INIT;
+
+    while (length--)
+    {
+        hash = ljson_hash_step(hash, *cp++);
+    }
+
+    return hash;
+}
+
+static void _ljson_inst_init(ljson_inst_t *inst, const ljson_item_t *item, uint16_t parent, uint8_t flag)
+{
+    inst->name = item->name;
+    inst->buffer = (uint8_t *)item->buffer;
+    switch (item->type)
+    {
+    case LJSON_ITEM_OBJECT:
+    case LJSON_ITEM_ARRAY:
+    case LJSON_ITEM_VECTOR:
+    case LJSON_ITEM_STREAM:
+    case LJSON_ITEM_UNION:
+        /* the item itself until its children are compiled */
+        inst->buffer = (uint8_t *)item;
+        break;
+    default:
+        break;
+    }
+    inst->hash = (item->name != 0) ? ljson_hash(item->name, (uint16_t)strlen(item->name)) : 0;
+    inst->length = item->length;
+    inst->offset = item->offset;
+    inst->child = LJSON_INST_NONE;
+    inst->parent = parent;
+    inst->type = item->type;
+    inst->flag = flag;
+}
+
+uint8_t ljson_schema_compile(ljson_schema_t *schema, ljson_inst_t *buffer, uint16_t size, const ljson_item_t *top)
+{
+    uint16_t i;
+    uint16_t j;
+    uint16_t count;
+    uint8_t flag;
+    ljson_inst_t *inst;
+    ljson_inst_t *tag;
+    const ljson_item_t *item;
+
+    schema->inst = buffer;
+    schema->count = 0;
+    schema->size = size;
+    if (size < 1)
+    {
+        return LJSON_ERROR_SCHEMA_OVER;
+    }
+    _ljson_inst_init(&schema->inst[schema->count++], top, LJSON_INST_NONE, LJSON_INST_FIXED);
+
+    /* breadth first, inst[] is the queue, so the children of one item are contiguous */
+    for (i = 0; i < schema->count; i++)
+    {
+        inst = &schema->inst[i];
+        flag = 0;
+        switch (inst->type)
+        {
+        case LJSON_ITEM_OBJECT:
+            count = inst->length;
+            flag = LJSON_INST_KEY | (inst->flag & LJSON_INST_FIXED);
             break;
-        case LJSON_ITEM_REAL: /* real, . e e+ e- E E+ E- */
-            cp += snprintf_real(cp, ((eob > cp) ? (eob - cp) : 0), item_buffer, contex->ljson_item->length);
+        case LJSON_ITEM_STREAM:
+            if (inst->length == 0)
+            {
+                /* the ring needs slots */
+                return LJSON_ERROR_ITEM_TYPE;
+            }
+            count = 1;
             break;
-        case LJSON_ITEM_BOOLEAN: /* true false TRUE FALSE */
-            cp += snprintf_token(cp, ((eob > cp) ? (eob - cp) : 0), (*(uint8_t*)item_buffer) ? "true" : "false");
+        case LJSON_ITEM_ARRAY:
+        case LJSON_ITEM_VECTOR:
+            count = 1;
             break;
-        case LJSON_ITEM_CALLBACK: /* callback */
-            cp += snprintf_token(cp, ((eob > cp) ? (eob - cp) : 0), "callback");
+        case LJSON_ITEM_UNION:
+            /* sibling index to the inst of the tag */
+            if ((inst->parent == LJSON_INST_NONE) || (schema->inst[inst->parent].type != LJSON_ITEM_OBJECT)
+                || (inst->offset >= schema->inst[inst->parent].length))
+            {
+                return LJSON_ERROR_ITEM_TAG;
+            }
+            inst->offset += schema->inst[inst->parent].child;
+            tag = &schema->inst[inst->offset];
+            if ((tag->type != LJSON_ITEM_STRING) && (tag->type != LJSON_ITEM_INTEGER))
+            {
+                return LJSON_ERROR_ITEM_TAG;
+            }
+            tag->flag |= LJSON_INST_TAG;
+            count = inst->length;
+            flag = LJSON_INST_CASE | (inst->flag & LJSON_INST_KEY);
             break;
         default:
-            /* never here */
-            break;
+            continue;
+        }
+        if (count > schema->size - schema->count)
+        {
+            return LJSON_ERROR_SCHEMA_OVER;
         }
 
-        contex->ljson_item_index++;
-
-        if (item_top->type == LJSON_ITEM_ARRAY)
+        /* see _ljson_inst_init */
+        item = (const ljson_item_t *)inst->buffer;
+        inst->buffer = (uint8_t *)item->count;
+        item = (const ljson_item_t *)item->buffer;
+        inst->child = schema->count;
+        for (j = 0; j < count; j++)
         {
-            contex->ljson_array_offset += item_top->offset;
+            _ljson_inst_init(&schema->inst[schema->count++], &item[j], i, flag);
         }
     }
 
-    return cp - cp_tmp;
+    return LJSON_ERROR_NONE;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-
-void ljson_parser_init(ljson_parser_t *parser, ljson_callback_t callback, void *user)
+/* leaves reached through objects only, LJSON_MASK_SIZE(schema->count) */
+void ljson_schema_want(const ljson_schema_t *schema, uint8_t *want)
 {
-    memset(parser, 0, sizeof(ljson_parser_t));
+    const ljson_inst_t *inst;
+    uint16_t i;
 
-    parser->state = LJSON_AWAIT_VALUE;
-    parser->user = user;
-    parser->callback = callback;
-    lstack_init(&parser->stack, parser->stack_buffer, LJSON_TYPE_STACK_SIZE);
+    memset(want, 0, LJSON_MASK_SIZE(schema->count));
+    ljson_mask_set(want, 0);
+    for (i = 1; i < schema->count; i++)
+    {
+        /* parents come first */
+        inst = &schema->inst[i];
+        if ((schema->inst[inst->parent].type == LJSON_ITEM_OBJECT) && ljson_mask_get(want, inst->parent))
+        {
+            ljson_mask_set(want, i);
+        }
+    }
+    for (i = 0; i < schema->count; i++)
+    {
+        if (schema->inst[i].type == LJSON_ITEM_OBJECT)
+        {
+            want[i >> 3] &= (uint8_t)~(1 << (i & 7));
+        }
+    }
 }
 
-uint8_t ljson_parser_feed(ljson_parser_t *parser, const void *buffer, uint16_t length)
+/* "teacher.name", "student[].old", length as snprintf */
+uint16_t ljson_schema_path(const ljson_schema_t *schema, uint16_t item, char *buffer, uint16_t size)
 {
-    const char *cp = (const char *)buffer;
-    const char *eob = cp + length;
-    uint8_t res;
+    const ljson_inst_t *inst;
+    const char *name;
+    uint16_t depth = 0;
+    uint16_t length = 0;
+    uint16_t i;
+    uint16_t j;
 
-    for (; cp < eob; cp++)
+    for (j = item; schema->inst[j].parent != LJSON_INST_NONE; j = schema->inst[j].parent)
     {
-        if (((uint8_t)(*cp) < 0x20) || ((uint8_t)(*cp) == 0x7F))
+        depth++;
+    }
+    /* from the top down */
+    while (depth > 0)
+    {
+        j = item;
+        for (i = 1; i < depth; i++)
         {
-            continue;
+            j = schema->inst[j].parent;
         }
-        if ((parser->state != LJSON_IN_STRING) && (*cp == ' '))
+        depth--;
+        inst = &schema->inst[j];
+        name = 0;
+        if (inst->flag & LJSON_INST_CASE)
         {
+            /* named by its union */
             continue;
         }
-
-        switch (parser->state)
+        if (inst->flag & LJSON_INST_KEY)
         {
-        case LJSON_AWAIT_KEY: /* '"', '}' */
-            if (*cp == '"')
+            if (length > 0)
             {
-                if (lstack_free(&parser->stack) < SIZE_OF_STACK_TYPE)
+                if (length + 1 < size)
                 {
-                    return LJSON_ERROR_STACK_OVER;
+                    buffer[length] = '.';
                 }
-                lstack_push(&parser->stack, LJSON_IN_KEY);
-                parser->pval = parser->parser_buffer;
-                parser->state = LJSON_IN_STRING;
-                break;
+                length++;
             }
-            if (*cp == '}')
+            name = (inst->name != 0) ? inst->name : "";
+        }
+        else if (ljson_item_is_array(schema->inst[inst->parent].type))
+        {
+            name = "[]";
+        }
+        while ((name != 0) && (*name != '\0'))
+        {
+            if (length + 1 < size)
             {
-                if ((lstack_is_empty(&parser->stack)) || (lstack_top(&parser->stack) != LJSON_IN_VAL_OBJECT))
-                {
-                    return LJSON_TYPE_OBJECT_R;
-                }
+                buffer[length] = *name;
+            }
+            name++;
+            length++;
+        }
+    }
+    if (size > 0)
+    {
+        buffer[(length < size) ? length : (size - 1)] = '\0';
+    }
 
-                res = parser->callback(LJSON_TYPE_OBJECT_R, 0, 0, parser->user);
-                if (res != LJSON_ERROR_NONE)
+    return length;
+}
+
+/* path and field the same, "[]" left out of both */
+static uint8_t _ljson_path_cmp(const char *path, const char *field, uint16_t length)
+{
+    const char *end = field + length;
+
+    while (1)
+    {
+        while ((path[0] == '[') && (path[1] == ']'))
+        {
+            path += 2;
+        }
+        while ((field + 1 < end) && (field[0] == '[') && (field[1] == ']'))
+        {
+            field += 2;
+        }
+        if ((field >= end) || (*path == '\0'))
+        {
+            return (field >= end) && (*path == '\0');
+        }
+        if (*path++ != *field++)
+        {
+            return 0;
+        }
+    }
+}
+
+/* next inst from item on whose path is field, LJSON_INST_NONE if none */
+static uint16_t _ljson_schema_find(const ljson_schema_t *schema, uint16_t item, const char *field, uint16_t length)
+{
+    char path[LJSON_BUFFER_SIZE];
+
+    for (; (length > 0) && (item < schema->count); item++)
+    {
+        if ((ljson_schema_path(schema, item, path, sizeof(path)) < sizeof(path)) && _ljson_path_cmp(path, field, length))
+        {
+            return item;
+        }
+    }
+
+    return LJSON_INST_NONE;
+}
+
+/* mark item with all under it and the containers above it */
+static void _ljson_schema_mark(const ljson_schema_t *schema, uint8_t *mask, uint16_t item)
+{
+    const ljson_inst_t *inst;
+    uint16_t first = item;
+    uint16_t last = item + 1;
+    uint16_t child;
+    uint16_t end = 0;
+    uint16_t i;
+
+    /* what is under item at one depth is contiguous, breadth first */
+    while (first < last)
+    {
+        child = LJSON_INST_NONE;
+        for (i = first; i < last; i++)
+        {
+            ljson_mask_set(mask, i);
+            inst = &schema->inst[i];
+            if (inst->child != LJSON_INST_NONE)
+            {
+                if (child == LJSON_INST_NONE)
+                {
+                    child = inst->child;
+                }
+                end = inst->child + (ljson_item_is_array(inst->type) ? 1 : inst->length);
+            }
+        }
+        if (child == LJSON_INST_NONE)
+        {
+            break;
+        }
+        first = child;
+        last = end;
+    }
+    for (i = item; schema->inst[i].parent != LJSON_INST_NONE; i = schema->inst[i].parent)
+    {
+        ljson_mask_set(mask, schema->inst[i].parent);
+    }
+}
+
+/* first inst on path, as from ljson_schema_path with "[]" left out or not, LJSON_INST_NONE if none */
+uint16_t ljson_schema_find(const ljson_schema_t *schema, const char *path)
+{
+    size_t length = strlen(path);
+
+    return _ljson_schema_find(schema, 1, path, (length < LJSON_BUFFER_SIZE) ? (uint16_t)length : 0);
+}
+
+/* mask of the insts written for fields "name,student.name", with what is under and above each */
+uint8_t ljson_schema_select(const ljson_schema_t *schema, uint8_t *mask, const char *fields)
+{
+    const char *field = fields;
+    uint16_t length;
+    uint16_t item;
+
+    memset(mask, 0, LJSON_MASK_SIZE(schema->count));
+    ljson_mask_set(mask, 0);
+    while (*field != '\0')
+    {
+        for (length = 0; (field[length] != ',') && (field[length] != '\0'); length++)
+        {
+        }
+        item = _ljson_schema_find(schema, 1, field, length);
+        if ((length > 0) && (item == LJSON_INST_NONE))
+        {
+            return LJSON_ERROR_ITEM_MISS;
+        }
+        while (item != LJSON_INST_NONE)
+        {
+            /* all the cases of a union share the path */
+            _ljson_schema_mark(schema, mask, item);
+            item = _ljson_schema_find(schema, item + 1, field, length);
+        }
+        field += (field[length] == ',') ? (length + 1) : length;
+    }
+
+    return LJSON_ERROR_NONE;
+}
+
+/* item changed, marked in dirty with the LJSON_INST_FIXED inst it is in: an array or union is sent whole */
+void ljson_schema_touch(const ljson_schema_t *schema, uint8_t *dirty, uint16_t item)
+{
+    while (!(schema->inst[item].flag & LJSON_INST_FIXED))
+    {
+        item = schema->inst[item].parent;
+    }
+    _ljson_schema_mark(schema, dirty, item);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ljson_contex_init(ljson_contex_t *contex, const ljson_schema_t *schema, void *base)
+{
+    memset(contex, 0, sizeof(ljson_contex_t));
+
+    contex->schema = schema;
+    contex->base = (uint8_t *)base;
+    contex->ljson_raw_item = LJSON_INST_NONE;
+}
+
+/* record bound insts in mask, stop with LJSON_ERROR_DONE once the ones in want are (0: never) */
+void ljson_contex_track(ljson_contex_t *contex, uint8_t *mask, const uint8_t *want)
+{
+    uint16_t i;
+
+    memset(mask, 0, LJSON_MASK_SIZE(contex->schema->count));
+    contex->mask = mask;
+    contex->want = want;
+    contex->ljson_item_want = 0;
+    for (i = 0; (want != 0) && (i < contex->schema->count); i++)
+    {
+        if (ljson_mask_get(want, i))
+        {
+            contex->ljson_item_want++;
+        }
+    }
+}
+
+/* bind LJSON_INST_FIXED insts only if their text hashes other than in print (zeroed before the first load) */
+void ljson_contex_fingerprint(ljson_contex_t *contex, uint32_t *print, uint8_t *change)
+{
+    memset(change, 0, LJSON_MASK_SIZE(contex->schema->count));
+    contex->print = print;
+    contex->change = change;
+}
+
+/* walk and write only the insts in project (from ljson_schema_select, 0: all), binding is not affected */
+void ljson_contex_project(ljson_contex_t *contex, const uint8_t *project)
+{
+    contex->project = project;
+}
+
+static uint8_t *_ljson_buffer(const ljson_inst_t *inst, uint8_t *base, uint32_t offset)
+{
+    if (base != 0)
+    {
+        return base + (size_t)inst->buffer + offset;
+    }
+
+    return inst->buffer + offset;
+}
+
+/* field of the container on the top, count of LJSON_ITEM_ARRAY, ljson_vector_t of LJSON_ITEM_VECTOR */
+static uint8_t *_ljson_contex_field(ljson_contex_t *contex)
+{
+    const ljson_frame_t *frame = &contex->stack[contex->level - 1];
+
+    return _ljson_buffer(&contex->schema->inst[frame->ljson_item], frame->base, frame->ljson_array_offset);
+}
+
+/* count of items in the container on the top */
+static uint32_t _ljson_contex_length(ljson_contex_t *contex)
+{
+    const ljson_inst_t *inst_top = ljson_contex_top(contex);
+    uint32_t count;
+
+    switch (inst_top->type)
+    {
+    case LJSON_ITEM_ARRAY:
+    case LJSON_ITEM_STREAM:
+        if (inst_top->buffer != 0)
+        {
+            count = *(uint32_t *)_ljson_contex_field(contex);
+            return (count < inst_top->length) ? count : inst_top->length;
+        }
+        break;
+    case LJSON_ITEM_VECTOR:
+        return ((ljson_vector_t *)_ljson_contex_field(contex))->count;
+    default:
+        break;
+    }
+
+    return inst_top->length;
+}
+
+/* no room for item ljson_item_index in the array on the top */
+static uint8_t _ljson_contex_over(ljson_contex_t *contex)
+{
+    const ljson_inst_t *inst_top = ljson_contex_top(contex);
+
+    if ((inst_top->type != LJSON_ITEM_ARRAY) && (inst_top->type != LJSON_ITEM_VECTOR))
+    {
+        return 0;
+    }
+
+    return (inst_top->length > 0) && (contex->ljson_item_index >= inst_top->length);
+}
+
+/* make room for item ljson_item_index of the LJSON_ITEM_VECTOR on the top */
+static uint8_t _ljson_contex_reserve(ljson_contex_t *contex)
+{
+    const ljson_inst_t *inst_top = ljson_contex_top(contex);
+    ljson_vector_t *vector = (ljson_vector_t *)_ljson_contex_field(contex);
+    uint8_t *buffer;
+    uint32_t size;
+
+    if (_ljson_contex_over(contex))
+    {
+        /* LJSON_ERROR_ARRAY_OVER by caller */
+        return LJSON_ERROR_NONE;
+    }
+    if (contex->ljson_item_index >= vector->size)
+    {
+        size = (vector->size > 0) ? (vector->size * 2) : LJSON_VECTOR_SIZE;
+        if ((inst_top->length > 0) && (size > inst_top->length))
+        {
+            size = inst_top->length;
+        }
+        if (contex->arena == 0)
+        {
+            return LJSON_ERROR_ARENA_OVER;
+        }
+        buffer = (uint8_t *)ljson_arena_realloc(contex->arena, vector->buffer, vector->size * inst_top->offset, size * inst_top->offset);
+        if (buffer == 0)
+        {
+            return LJSON_ERROR_ARENA_OVER;
+        }
+        vector->buffer = buffer;
+        vector->size = size;
+    }
+    contex->base = (uint8_t *)vector->buffer;
+    memset(contex->base + contex->ljson_array_offset, 0, inst_top->offset);
+    vector->count = contex->ljson_item_index + 1;
+
+    return LJSON_ERROR_NONE;
+}
+
+/* case of the LJSON_ITEM_UNION item in the object on the top, by the value of its tag */
+static uint16_t _ljson_contex_select(ljson_contex_t *contex, uint16_t item)
+{
+    const ljson_inst_t *inst = &contex->schema->inst[item];
+    const ljson_inst_t *tag = &contex->schema->inst[inst->offset];
+    const ljson_inst_t *inst_case;
+    const char *value = (const char *)_ljson_buffer(tag, contex->base, contex->ljson_array_offset);
+    char number[24];
+    uint16_t length = 0;
+    uint32_t hash;
+    uint16_t i;
+
+    if (tag->type == LJSON_ITEM_INTEGER)
+    {
+        length = snprintf_integer(number, sizeof(number), value, tag->length);
+        value = number;
+    }
+    else
+    {
+        while ((length < tag->length) && (value[length] != '\0'))
+        {
+            length++;
+        }
+    }
+    hash = ljson_hash(value, length);
+    for (i = 0; i < inst->length; i++)
+    {
+        inst_case = &contex->schema->inst[inst->child + i];
+        if ((inst_case->hash == hash) && (strncmp(inst_case->name, value, length) == 0) && (inst_case->name[length] == '\0'))
+        {
+            return inst->child + i;
+        }
+    }
+
+    return LJSON_INST_NONE;
+}
+
+uint8_t ljson_contex_push(ljson_contex_t *contex, uint8_t type)
+{
+    const ljson_inst_t *inst;
+    ljson_frame_t *frame;
+
+    if (contex->ljson_item == LJSON_INST_NONE)
+    {
+        contex->ljson_item_miss++;
+        return LJSON_ERROR_NONE;
+    }
+    inst = ljson_contex_inst(contex);
+    switch (type)
+    {
+    case LJSON_TYPE_OBJECT_L:
+        if (inst->type != LJSON_ITEM_OBJECT)
+        {
+            return LJSON_ERROR_OBJECT_L;
+        }
+        break;
+    case LJSON_TYPE_ARRAY_L:
+        if (!ljson_item_is_array(inst->type))
+        {
+            return LJSON_ERROR_ARRAY_L;
+        }
+        break;
+    default:
+        break;
+    }
+    if ((contex->level > 0) && _ljson_contex_over(contex))
+    {
+#ifdef LJSON_ERROR_ARRAY_OVER_IGNORE
+        contex->ljson_item = LJSON_INST_NONE;
+        contex->ljson_item_miss++;
+        return LJSON_ERROR_NONE;
+#else
+        return LJSON_ERROR_ARRAY_OVER;
+#endif
+    }
+    if (contex->level >= LJSON_CONTEX_STACK_SIZE)
+    {
+        return LJSON_ERROR_STACK_OVER;
+    }
+    frame = &contex->stack[contex->level++];
+    frame->base = contex->base;
+    frame->ljson_array_offset = contex->ljson_array_offset;
+    frame->ljson_item = contex->ljson_item;
+    frame->ljson_item_index = contex->ljson_item_index;
+    frame->flag = 0;
+
+    contex->ljson_item_index = 0;
+    switch (inst->type)
+    {
+    case LJSON_ITEM_OBJECT:
+        contex->ljson_array_offset += inst->offset;
+        break;
+    case LJSON_ITEM_VECTOR:
+        contex->base = (uint8_t *)((ljson_vector_t *)_ljson_contex_field(contex))->buffer;
+        contex->ljson_array_offset = 0;
+        break;
+    default:
+        break;
+    }
+
+    return LJSON_ERROR_NONE;
+}
+
+static void _ljson_contex_step(ljson_contex_t *contex)
+{
+    const ljson_inst_t *inst_top;
+
+    contex->ljson_item_index++;
+    if (contex->level > 0)
+    {
+        inst_top = ljson_contex_top(contex);
+        if (ljson_item_is_array(inst_top->type))
+        {
+            contex->ljson_array_offset += inst_top->offset;
+            if ((inst_top->type == LJSON_ITEM_STREAM) && (contex->ljson_item_index % inst_top->length == 0))
+            {
+                /* back to slot 0 */
+                contex->ljson_array_offset -= (uint32_t)inst_top->offset * inst_top->length;
+            }
+        }
+    }
+}
+
+static void _ljson_contex_restore(ljson_contex_t *contex)
+{
+    const ljson_frame_t *frame = &contex->stack[--contex->level];
+
+    contex->base = frame->base;
+    contex->ljson_item = frame->ljson_item;
+    contex->ljson_item_index = frame->ljson_item_index;
+    contex->ljson_array_offset = frame->ljson_array_offset;
+}
+
+uint8_t ljson_contex_pop(ljson_contex_t *contex, uint8_t type)
+{
+    if (contex->ljson_item_miss > 0)
+    {
+        contex->ljson_item_miss--;
+        return LJSON_ERROR_NONE;
+    }
+    if (contex->level == 0)
+    {
+        return (type == LJSON_TYPE_OBJECT_R) ? LJSON_ERROR_OBJECT_R : LJSON_ERROR_ARRAY_R;
+    }
+    _ljson_contex_restore(contex);
+    _ljson_contex_step(contex);
+
+    return LJSON_ERROR_NONE;
+}
+
+/* walk the schema in document order, one event (LJSON_TYPE_XXX) per call */
+uint8_t ljson_contex_next(ljson_contex_t *contex, uint8_t *type)
+{
+    const ljson_inst_t *inst_top;
+    uint16_t item;
+
+    if (contex->ljson_item_step)
+    {
+        contex->ljson_item_step = 0;
+        _ljson_contex_step(contex);
+    }
+    if (contex->level > 0)
+    {
+        inst_top = ljson_contex_top(contex);
+        while ((contex->project != 0) && (inst_top->type == LJSON_ITEM_OBJECT) && (contex->ljson_item_index < inst_top->length)
+            && !ljson_mask_get(contex->project, inst_top->child + contex->ljson_item_index))
+        {
+            /* member left out, with all under it */
+            contex->ljson_item_index++;
+        }
+        if (contex->ljson_item_index >= _ljson_contex_length(contex))
+        {
+            /* ljson_contex_buffer is the field of the container until the next call */
+            *type = (inst_top->type == LJSON_ITEM_OBJECT) ? LJSON_TYPE_OBJECT_R : LJSON_TYPE_ARRAY_R;
+            _ljson_contex_restore(contex);
+            contex->ljson_item_step = 1;
+            return LJSON_ERROR_NONE;
+        }
+        contex->ljson_item = inst_top->child;
+        if (inst_top->type == LJSON_ITEM_OBJECT)
+        {
+            contex->ljson_item += contex->ljson_item_index;
+        }
+        if (ljson_contex_inst(contex)->type == LJSON_ITEM_UNION)
+        {
+            /* no case: a LJSON_TYPE_TOKEN of the union itself */
+            item = _ljson_contex_select(contex, contex->ljson_item);
+            if (item != LJSON_INST_NONE)
+            {
+                contex->ljson_item = item;
+            }
+        }
+    }
+    else if (contex->ljson_item_index > 0)
+    {
+        *type = LJSON_TYPE_NONE;
+        return LJSON_ERROR_NONE;
+    }
+
+    switch (ljson_contex_inst(contex)->type)
+    {
+    case LJSON_ITEM_OBJECT:
+        *type = LJSON_TYPE_OBJECT_L;
+        return ljson_contex_push(contex, *type);
+    case LJSON_ITEM_ARRAY:
+    case LJSON_ITEM_VECTOR:
+    case LJSON_ITEM_STREAM:
+        *type = LJSON_TYPE_ARRAY_L;
+        return ljson_contex_push(contex, *type);
+    case LJSON_ITEM_STRING:
+        *type = LJSON_TYPE_STRING;
+        break;
+    default:
+        *type = LJSON_TYPE_TOKEN;
+        break;
+    }
+    contex->ljson_item_step = 1;
+
+    return LJSON_ERROR_NONE;
+}
+
+uint8_t *ljson_contex_buffer(ljson_contex_t *contex)
+{
+    const ljson_inst_t *inst = ljson_contex_inst(contex);
+
+    if (inst->type == LJSON_ITEM_CALLBACK)
+    {
+        return inst->buffer;
+    }
+
+    return _ljson_buffer(inst, contex->base, contex->ljson_array_offset);
+}
+
+/* items in the container on the top */
+uint32_t ljson_contex_count(ljson_contex_t *contex)
+{
+    return (contex->level > 0) ? _ljson_contex_length(contex) : 0;
+}
+
+/* go to item index of the LJSON_ITEM_ARRAY or LJSON_ITEM_VECTOR on the top */
+uint8_t ljson_contex_seek(ljson_contex_t *contex, uint32_t index)
+{
+    const ljson_inst_t *inst_top;
+
+    if (contex->level == 0)
+    {
+        return LJSON_ERROR_ARRAY_L;
+    }
+    inst_top = ljson_contex_top(contex);
+    if ((inst_top->type != LJSON_ITEM_ARRAY) && (inst_top->type != LJSON_ITEM_VECTOR))
+    {
+        return LJSON_ERROR_ARRAY_L;
+    }
+    if (contex->ljson_item_step)
+    {
+        contex->ljson_item_step = 0;
+        _ljson_contex_step(contex);
+    }
+    contex->ljson_array_offset += (index - contex->ljson_item_index) * inst_top->offset;
+    contex->ljson_item_index = index;
+
+    return LJSON_ERROR_NONE;
+}
+
+/* zero every field under the current item, counts of arrays included */
+static void _ljson_contex_reset(ljson_contex_t *contex)
+{
+    ljson_contex_t walk = *contex;
+    const ljson_inst_t *inst;
+    uint8_t type;
+
+    walk.level = 0;
+    walk.ljson_item_index = 0;
+    walk.ljson_item_step = 0;
+    walk.ljson_item_miss = 0;
+    walk.project = 0;
+    while ((ljson_contex_next(&walk, &type) == LJSON_ERROR_NONE) && (type != LJSON_TYPE_NONE))
+    {
+        inst = ljson_contex_inst(&walk);
+        switch (type)
+        {
+        case LJSON_TYPE_TOKEN:
+        case LJSON_TYPE_STRING:
+            if ((inst->type == LJSON_ITEM_RAW) && (inst->length == 0))
+            {
+                memset(ljson_contex_buffer(&walk), 0, sizeof(ljson_raw_t));
+            }
+            else if ((inst->type != LJSON_ITEM_CALLBACK) && (inst->type != LJSON_ITEM_UNION))
+            {
+                memset(ljson_contex_buffer(&walk), 0, inst->length);
+            }
+            break;
+        case LJSON_TYPE_ARRAY_R:
+            if (inst->type == LJSON_ITEM_VECTOR)
+            {
+                ((ljson_vector_t *)ljson_contex_buffer(&walk))->count = 0;
+            }
+            else if (inst->buffer != 0)
+            {
+                *(uint32_t *)ljson_contex_buffer(&walk) = 0;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/* value of the current leaf */
+static uint8_t _ljson_contex_value(ljson_contex_t *contex, ljson_writer_t *writer, const ljson_inst_t *inst)
+{
+    uint8_t *item_buffer;
+    ljson_raw_t raw;
+    char number[32];
+    uint32_t length;
+    uint32_t call;
+    uint8_t res;
+
+    item_buffer = ljson_contex_buffer(contex);
+    switch (inst->type)
+    {
+    case LJSON_ITEM_STRING: /* "chars" null */
+        _ljson_writer_string(writer, item_buffer, inst->length, 1);
+        break;
+    case LJSON_ITEM_INTEGER: /* int */
+        ljson_writer_write(writer, number, snprintf_integer(number, sizeof(number), item_buffer, inst->length));
+        break;
+    case LJSON_ITEM_UNSIGNED: /* unsigned int */
+        ljson_writer_write(writer, number, snprintf_unsigned(number, sizeof(number), item_buffer, inst->length));
+        break;
+    case LJSON_ITEM_REAL: /* real, . e e+ e- E E+ E- */
+        ljson_writer_write(writer, number, snprintf_real(number, sizeof(number), item_buffer, inst->length));
+        break;
+    case LJSON_ITEM_BOOLEAN: /* true false TRUE FALSE */
+        ljson_writer_write(writer, (*(uint8_t*)item_buffer) ? "true" : "false", (*(uint8_t*)item_buffer) ? 4 : 5);
+        break;
+    case LJSON_ITEM_CALLBACK: /* produced by the callback, null if nothing */
+        length = writer->length;
+        call = 0;
+        do
+        {
+            /* set each time, a nested write may have used it */
+            writer->call = call;
+            res = ((ljson_callback_t)item_buffer)(LJSON_TYPE_WRITE, (uint8_t *)writer, (uint16_t)((call < 0xFFFF) ? call : 0xFFFF), contex);
+            call++;
+        } while ((res == LJSON_ERROR_MORE) && (writer->error == LJSON_ERROR_NONE));
+        if (res != LJSON_ERROR_NONE)
+        {
+            return res;
+        }
+        if (writer->length == length)
+        {
+            ljson_writer_write(writer, "null", 4);
+        }
+        break;
+    case LJSON_ITEM_UNION: /* no case for the tag */
+        ljson_writer_write(writer, "null", 4);
+        break;
+    case LJSON_ITEM_RAW: /* text as is, null if never bound */
+        if (inst->length == 0)
+        {
+            raw = *(ljson_raw_t *)item_buffer;
+        }
+        else
+        {
+            raw.buffer = (const char *)item_buffer;
+            raw.length = (uint32_t)strlen(raw.buffer);
+        }
+        if (raw.length > 0)
+        {
+            ljson_writer_reference(writer, raw.buffer, raw.length);
+        }
+        else
+        {
+            ljson_writer_write(writer, "null", 4);
+        }
+        break;
+    default:
+        /* never here */
+        break;
+    }
+
+    return LJSON_ERROR_NONE;
+}
+
+/* the field at buffer the same in snapshot, a copy of the struct at base */
+static uint8_t _ljson_contex_same(ljson_contex_t *contex, const ljson_inst_t *inst, const uint8_t *snapshot)
+{
+    const uint8_t *buffer = ljson_contex_buffer(contex);
+    const uint8_t *old = snapshot + (buffer - contex->base);
+    const ljson_raw_t *raw;
+    const ljson_raw_t *raw_old;
+
+    switch (inst->type)
+    {
+    case LJSON_ITEM_ARRAY: /* the count, the items one by one after */
+        return (inst->buffer == 0) || (*(const uint32_t *)buffer == *(const uint32_t *)old);
+    case LJSON_ITEM_STRING:
+        return strncmp((const char *)buffer, (const char *)old, inst->length) == 0;
+    case LJSON_ITEM_RAW:
+        if (inst->length > 0)
+        {
+            return strncmp((const char *)buffer, (const char *)old, inst->length) == 0;
+        }
+        raw = (const ljson_raw_t *)buffer;
+        raw_old = (const ljson_raw_t *)old;
+        return (raw->length == raw_old->length) && ((raw->length == 0) || (memcmp(raw->buffer, raw_old->buffer, raw->length) == 0));
+    default:
+        return memcmp(buffer, old, inst->length) == 0;
+    }
+}
+
+/* bytes before the first item of the LJSON_ITEM_ARRAY on the top, 0xFFFFFFFF if items hold more than their bytes */
+static uint32_t _ljson_contex_items(ljson_contex_t *contex)
+{
+    const ljson_schema_t *schema = contex->schema;
+    const ljson_inst_t *inst = ljson_contex_top(contex);
+    const ljson_inst_t *first;
+    uint16_t item = contex->stack[contex->level - 1].ljson_item;
+    uint16_t i;
+    uint16_t j;
+
+    for (first = &schema->inst[inst->child]; first->type == LJSON_ITEM_ARRAY; first = &schema->inst[first->child])
+    {
+        if (first->buffer != 0)
+        {
+            return 0xFFFFFFFF;
+        }
+    }
+    /* parents come first */
+    for (i = inst->child; i < schema->count; i++)
+    {
+        for (j = i; (j != LJSON_INST_NONE) && (j > item); j = schema->inst[j].parent)
+        {
+        }
+        inst = &schema->inst[i];
+        if ((j == item) && ((inst->type == LJSON_ITEM_VECTOR) || (inst->type == LJSON_ITEM_STREAM) || (inst->type == LJSON_ITEM_CALLBACK)
+            || ((inst->type == LJSON_ITEM_RAW) && (inst->length == 0))))
+        {
+            return 0xFFFFFFFF;
+        }
+    }
+
+    return (first->type == LJSON_ITEM_OBJECT) ? first->offset : (uint32_t)(size_t)first->buffer;
+}
+
+/* mark in dirty what differs from snapshot, a copy of the struct at base taken before,
+   the merge patch is then written with ljson_contex_project(contex, dirty) */
+uint8_t ljson_contex_compare(ljson_contex_t *contex, uint8_t *dirty, const void *snapshot)
+{
+    ljson_contex_t walk = *contex;
+    const ljson_inst_t *inst;
+    uint32_t offset;
+    uint16_t item;
+    uint8_t type;
+    uint8_t res;
+
+    if (contex->base == 0)
+    {
+        /* fields must be offsets */
+        return LJSON_ERROR_ITEM_TYPE;
+    }
+    walk.level = 0;
+    walk.ljson_item_index = 0;
+    walk.ljson_item_step = 0;
+    walk.ljson_item_miss = 0;
+    walk.project = 0;
+    while (1)
+    {
+        res = ljson_contex_next(&walk, &type);
+        if ((res != LJSON_ERROR_NONE) || (type == LJSON_TYPE_NONE))
+        {
+            return res;
+        }
+        if ((type == LJSON_TYPE_OBJECT_L) || (type == LJSON_TYPE_OBJECT_R) || (type == LJSON_TYPE_ARRAY_R))
+        {
+            continue;
+        }
+        for (item = walk.ljson_item; !(contex->schema->inst[item].flag & LJSON_INST_FIXED); item = contex->schema->inst[item].parent)
+        {
+        }
+        if (ljson_mask_get(dirty, item))
+        {
+            /* sent whole */
+            continue;
+        }
+        inst = ljson_contex_inst(&walk);
+        switch (inst->type)
+        {
+        case LJSON_ITEM_VECTOR: /* elements out of the struct, not in the snapshot */
+        case LJSON_ITEM_STREAM:
+        case LJSON_ITEM_CALLBACK:
+            ljson_schema_touch(contex->schema, dirty, item);
+            break;
+        case LJSON_ITEM_UNION: /* no case, null */
+            break;
+        case LJSON_ITEM_ARRAY:
+            if (!_ljson_contex_same(&walk, inst, (const uint8_t *)snapshot))
+            {
+                ljson_schema_touch(contex->schema, dirty, item);
+                break;
+            }
+            /* items with the same bytes at once, else one by one */
+            offset = _ljson_contex_items(&walk);
+            if ((offset != 0xFFFFFFFF) && (memcmp(walk.base + walk.ljson_array_offset + offset,
+                (const uint8_t *)snapshot + walk.ljson_array_offset + offset, (size_t)_ljson_contex_length(&walk) * inst->offset) == 0))
+            {
+                walk.ljson_item_index = 0xFFFFFFFF;
+            }
+            break;
+        default:
+            if (!_ljson_contex_same(&walk, inst, (const uint8_t *)snapshot))
+            {
+                ljson_schema_touch(contex->schema, dirty, item);
+            }
+            break;
+        }
+    }
+}
+
+/* items of the array on the top if numbers in its own storage, one after another into the block of writer */
+static uint8_t _ljson_contex_numbers(ljson_contex_t *contex, ljson_writer_t *writer)
+{
+    const ljson_inst_t *inst_top = ljson_contex_top(contex);
+    const ljson_inst_t *inst = &contex->schema->inst[inst_top->child];
+    const uint8_t *item_buffer;
+    char number[32];
+    char *cp;
+    uint32_t count;
+    uint32_t i;
+    uint16_t length;
+
+    if (((inst_top->type != LJSON_ITEM_ARRAY) && (inst_top->type != LJSON_ITEM_VECTOR))
+        || ((inst->type != LJSON_ITEM_INTEGER) && (inst->type != LJSON_ITEM_UNSIGNED) && (inst->type != LJSON_ITEM_REAL)))
+    {
+        return 0;
+    }
+
+    count = _ljson_contex_length(contex);
+    item_buffer = _ljson_buffer(inst, contex->base, contex->ljson_array_offset);
+    for (i = 0; (i < count) && (writer->error == LJSON_ERROR_NONE); i++)
+    {
+        /* in place while the block has room for a number, its ',' and '\0' */
+        cp = ((writer->iov == 0) && ((uint16_t)(writer->size - writer->used) >= sizeof(number))) ? (writer->buffer + writer->used) : number;
+        length = 0;
+        if (i > 0)
+        {
+            cp[length++] = ',';
+        }
+        switch (inst->type)
+        {
+        case LJSON_ITEM_INTEGER:
+            length += snprintf_integer(cp + length, sizeof(number) - length, item_buffer, inst->length);
+            break;
+        case LJSON_ITEM_UNSIGNED:
+            length += snprintf_unsigned(cp + length, sizeof(number) - length, item_buffer, inst->length);
+            break;
+        default:
+            length += snprintf_real(cp + length, sizeof(number) - length, item_buffer, inst->length);
+            break;
+        }
+        if (cp == number)
+        {
+            ljson_writer_write(writer, number, length);
+        }
+        else
+        {
+            writer->used += length;
+            writer->length += length;
+        }
+        item_buffer += inst_top->offset;
+    }
+    /* LJSON_TYPE_ARRAY_R next */
+    contex->ljson_item_index = 0xFFFFFFFF;
+
+    return 1;
+}
+
+/* from where the walk is, LJSON_ERROR_MORE after the '{' or '[' of item, or up to count items of the container on the top */
+static uint8_t _ljson_contex_emit(ljson_contex_t *contex, ljson_writer_t *writer, uint8_t fmt, uint16_t item, uint32_t count)
+{
+    uint8_t res;
+    uint8_t type;
+    uint8_t comma = 0;
+    uint8_t level = 0;
+    uint8_t i;
+    const ljson_inst_t *inst;
+    uint8_t top = contex->level;
+    uint32_t end = contex->ljson_item_index + contex->ljson_item_step + count;
+
+    while (writer->error == LJSON_ERROR_NONE)
+    {
+        if ((count > 0) && (contex->level == top) && (contex->ljson_item_index + contex->ljson_item_step >= end))
+        {
+            break;
+        }
+        res = ljson_contex_next(contex, &type);
+        if (res != LJSON_ERROR_NONE)
+        {
+            return res;
+        }
+        if (type == LJSON_TYPE_NONE)
+        {
+            break;
+        }
+        inst = ljson_contex_inst(contex);
+
+        if ((type == LJSON_TYPE_OBJECT_R) || (type == LJSON_TYPE_ARRAY_R))
+        {
+            if (fmt)
+            {
+                level--;
+                if (comma)
+                {
+                    ljson_writer_write(writer, "\r\n", 2);
+                    for (i = 0; i < level; i++)
+                    {
+                        ljson_writer_write(writer, "    ", 4);
+                    }
+                }
+            }
+            ljson_writer_write(writer, (type == LJSON_TYPE_OBJECT_R) ? "}" : "]", 1);
+            comma = 1;
+            continue;
+        }
+
+        if (comma)
+        {
+            ljson_writer_write(writer, fmt ? ",\r\n" : ",", fmt ? 3 : 1);
+        }
+        for (i = 0; fmt && (i < level); i++)
+        {
+            ljson_writer_write(writer, "    ", 4);
+        }
+        if (inst->flag & LJSON_INST_KEY)
+        {
+            if (inst->name == 0)
+            {
+                /* error */
+                return LJSON_ERROR_ITEM_NAME;
+            }
+
+            /* a case is written under the name of its union */
+            ljson_writer_string(writer, (inst->flag & LJSON_INST_CASE) ? contex->schema->inst[inst->parent].name : inst->name, 0);
+            ljson_writer_write(writer, ":", 1);
+        }
+
+        if ((type == LJSON_TYPE_OBJECT_L) || (type == LJSON_TYPE_ARRAY_L))
+        {
+            ljson_writer_write(writer, (type == LJSON_TYPE_OBJECT_L) ? "{" : "[", 1);
+            if (contex->ljson_item == item)
+            {
+                return LJSON_ERROR_MORE;
+            }
+            if (fmt)
+            {
+                level++;
+                if (_ljson_contex_length(contex) > 0)
+                {
+                    ljson_writer_write(writer, "\r\n", 2);
+                }
+            }
+            else
+            {
+                _ljson_contex_numbers(contex, writer);
+            }
+            comma = 0;
+            continue;
+        }
+
+        res = _ljson_contex_value(contex, writer, inst);
+        if (res != LJSON_ERROR_NONE)
+        {
+            return res;
+        }
+        comma = 1;
+    }
+
+    return writer->error;
+}
+
+/* the document in one pass, the sink flushed at the end */
+uint8_t ljson_contex_write(ljson_contex_t *contex, ljson_writer_t *writer, uint8_t fmt)
+{
+    uint8_t res;
+
+    res = _ljson_contex_emit(contex, writer, fmt, LJSON_INST_NONE, 0);
+    if (res != LJSON_ERROR_NONE)
+    {
+        return res;
+    }
+
+    return ljson_writer_flush(writer);
+}
+
+/* as ljson_contex_write without fmt, not flushed: LJSON_ERROR_MORE with the walk just in item (LJSON_INST_NONE: never),
+   or count items (0: all) of the container on the top, the first with no ',' before it */
+uint8_t ljson_contex_write_part(ljson_contex_t *contex, ljson_writer_t *writer, uint16_t item, uint32_t count)
+{
+    return _ljson_contex_emit(contex, writer, 0, item, count);
+}
+
+uint16_t ljson_contex_snprintf(ljson_contex_t *contex, void *buffer, uint16_t size, uint8_t fmt)
+{
+    ljson_writer_t writer;
+
+    /* room for '\0', the rest only counted */
+    ljson_writer_init(&writer, buffer, (size > 0) ? (size - 1) : 0, 0, 0);
+    if (ljson_contex_write(contex, &writer, fmt) != LJSON_ERROR_NONE)
+    {
+        return 0;
+    }
+    if (size > 0)
+    {
+        ((char *)buffer)[writer.used] = '\0';
+    }
+
+    return (uint16_t)writer.length;
+}
+
+/* RFC 7386 patch from the struct at old_base to the one at new_base, dirty LJSON_MASK_SIZE(schema->count) */
+uint8_t ljson_diff(const ljson_schema_t *schema, const void *old_base, void *new_base, uint8_t *dirty, ljson_writer_t *writer)
+{
+    ljson_contex_t contex;
+    uint8_t res;
+
+    memset(dirty, 0, LJSON_MASK_SIZE(schema->count));
+    ljson_contex_init(&contex, schema, new_base);
+    res = ljson_contex_compare(&contex, dirty, old_base);
+    if (res != LJSON_ERROR_NONE)
+    {
+        return res;
+    }
+    ljson_contex_init(&contex, schema, new_base);
+    ljson_contex_project(&contex, dirty);
+
+    return ljson_contex_write(&contex, writer, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* offset has schema->count + 1 entries, buffer keeps the text, both live as long as serializer */
+uint8_t ljson_serializer_compile(ljson_serializer_t *serializer, const ljson_schema_t *schema, uint16_t *offset, char *buffer, uint16_t size)
+{
+    const ljson_inst_t *inst;
+    ljson_writer_t writer;
+    uint16_t i;
+
+    /* the rest only counted, over if anything is */
+    ljson_writer_init(&writer, buffer, size, 0, 0);
+    for (i = 0; i < schema->count; i++)
+    {
+        inst = &schema->inst[i];
+        offset[i] = (uint16_t)writer.length;
+        ljson_writer_write(&writer, ",", 1);
+        if (inst->flag & LJSON_INST_KEY)
+        {
+            if (inst->name == 0)
+            {
+                /* error */
+                return LJSON_ERROR_ITEM_NAME;
+            }
+
+            /* a case is written under the name of its union */
+            ljson_writer_string(&writer, (inst->flag & LJSON_INST_CASE) ? schema->inst[inst->parent].name : inst->name, 0);
+            ljson_writer_write(&writer, ":", 1);
+        }
+        if (inst->type == LJSON_ITEM_OBJECT)
+        {
+            ljson_writer_write(&writer, "{", 1);
+        }
+        else if (ljson_item_is_array(inst->type))
+        {
+            ljson_writer_write(&writer, "[", 1);
+        }
+        if (writer.length > size)
+        {
+            return LJSON_ERROR_BUFFER_OVER;
+        }
+    }
+    offset[schema->count] = (uint16_t)writer.length;
+
+    serializer->schema = schema;
+    serializer->buffer = buffer;
+    serializer->offset = offset;
+
+    return LJSON_ERROR_NONE;
+}
+
+/* as ljson_contex_write without fmt, the text between values copied as compiled */
+uint8_t ljson_serializer_write(const ljson_serializer_t *serializer, ljson_contex_t *contex, ljson_writer_t *writer)
+{
+    uint8_t res;
+    uint8_t type;
+    uint8_t comma = 0;
+    const uint16_t *offset;
+
+    if (contex->schema != serializer->schema)
+    {
+        return LJSON_ERROR_ITEM_TYPE;
+    }
+    while (writer->error == LJSON_ERROR_NONE)
+    {
+        res = ljson_contex_next(contex, &type);
+        if (res != LJSON_ERROR_NONE)
+        {
+            return res;
+        }
+        switch (type)
+        {
+        case LJSON_TYPE_NONE:
+            return ljson_writer_flush(writer);
+        case LJSON_TYPE_OBJECT_R:
+        case LJSON_TYPE_ARRAY_R:
+            ljson_writer_write(writer, (type == LJSON_TYPE_OBJECT_R) ? "}" : "]", 1);
+            comma = 1;
+            break;
+        default:
+            /* the ',' of the fragment only after another item */
+            offset = &serializer->offset[contex->ljson_item];
+            ljson_writer_write(writer, serializer->buffer + offset[0] + !comma, offset[1] - offset[0] - !comma);
+            comma = (type != LJSON_TYPE_OBJECT_L) && (type != LJSON_TYPE_ARRAY_L);
+            if (type == LJSON_TYPE_ARRAY_L)
+            {
+                _ljson_contex_numbers(contex, writer);
+            }
+            else if (comma)
+            {
+                res = _ljson_contex_value(contex, writer, ljson_contex_inst(contex));
+                if (res != LJSON_ERROR_NONE)
                 {
                     return res;
                 }
-                lstack_pop(&parser->stack);
-                parser->state = LJSON_AWAIT_COMMA;
+            }
+            break;
+        }
+    }
+
+    return ljson_writer_flush(writer);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint8_t ljson_dict_init(ljson_dict_t *dict, const char *const *name, uint16_t count, uint16_t *slot, uint16_t size)
+{
+    uint16_t i;
+    uint16_t j;
+
+    if ((size <= count) || ((size & (size - 1)) != 0))
+    {
+        return LJSON_ERROR_BUFFER_OVER;
+    }
+    dict->name = name;
+    dict->count = count;
+    dict->slot = slot;
+    dict->size = size;
+    memset(slot, 0, size * sizeof(uint16_t));
+    for (i = 0; i < count; i++)
+    {
+        j = (uint16_t)ljson_hash(name[i], (uint16_t)strlen(name[i]));
+        while (slot[j & (size - 1)] != 0)
+        {
+            j++;
+        }
+        slot[j & (size - 1)] = i + 1;
+    }
+
+    return LJSON_ERROR_NONE;
+}
+
+/* id of key, hash is its ljson_hash */
+uint16_t ljson_dict_find(const ljson_dict_t *dict, uint32_t hash, const void *key, uint16_t length)
+{
+    uint16_t j = (uint16_t)hash;
+    uint16_t id;
+
+    while ((id = dict->slot[j & (dict->size - 1)]) != 0)
+    {
+        id--;
+        if ((strncmp(dict->name[id], (const char *)key, length) == 0) && (dict->name[id][length] == '\0'))
+        {
+            return id;
+        }
+        j++;
+    }
+
+    return LJSON_KEY_NONE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ljson_parser_init(ljson_parser_t *parser, ljson_callback_t callback, void *user)
+{
+    memset(parser, 0, sizeof(ljson_parser_t));
+
+    parser->state = LJSON_AWAIT_VALUE;
+    parser->user = user;
+    parser->callback = callback;
+    lstack_init(&parser->stack, parser->stack_buffer, LJSON_TYPE_STACK_SIZE);
+}
+
+/* a callback stopped the feed, bytes before end consumed */
+static uint8_t _ljson_parser_stop(ljson_parser_t *parser, const void *buffer, const char *end, uint8_t res)
+{
+    parser->used = (uint16_t)(end - (const char *)buffer);
+
+    return res;
+}
+
+/* text of the value being captured, the rest of it if done */
+static uint8_t _ljson_parser_raw(ljson_parser_t *parser, const char *raw, const char *end, uint8_t done)
+{
+    if (parser->state == LJSON_IN_RAW_TOKEN)
+    {
+        /* whitespace ends a token, it is not part of it */
+        while ((end > raw) && (((uint8_t)end[-1] <= 0x20) || ((uint8_t)end[-1] == 0x7F)))
+        {
+            end--;
+        }
+    }
+    if (done)
+    {
+        parser->state = LJSON_AWAIT_COMMA;
+        return parser->callback(LJSON_TYPE_RAW_END, (uint8_t *)raw, (uint16_t)(end - raw), parser->user);
+    }
+    if (end > raw)
+    {
+        return parser->callback(LJSON_TYPE_RAW, (uint8_t *)raw, (uint16_t)(end - raw), parser->user);
+    }
+
+    return LJSON_ERROR_NONE;
+}
+
+uint8_t ljson_parser_feed(ljson_parser_t *parser, const void *buffer, uint16_t length)
+{
+    const char *cp = (const char *)buffer;
+    const char *eob = cp + length;
+    const char *raw = (parser->state >= LJSON_IN_RAW) ? cp : 0;
+    uint8_t res;
+
+    parser->used = length;
+    for (; cp < eob; cp++)
+    {
+        if (((uint8_t)(*cp) < 0x20) || ((uint8_t)(*cp) == 0x7F))
+        {
+            continue;
+        }
+        if ((parser->state != LJSON_IN_STRING) && (*cp == ' '))
+        {
+            continue;
+        }
+
+        switch (parser->state)
+        {
+        case LJSON_AWAIT_KEY: /* '"', '}' */
+            if (*cp == '"')
+            {
+                if (lstack_free(&parser->stack) < SIZE_OF_STACK_TYPE)
+                {
+                    return LJSON_ERROR_STACK_OVER;
+                }
+                lstack_push(&parser->stack, LJSON_IN_KEY);
+                parser->pval = parser->parser_buffer;
+                parser->hash = LJSON_HASH_INIT;
+                parser->state = LJSON_IN_STRING;
+                break;
+            }
+            if (*cp == '}')
+            {
+                if ((lstack_is_empty(&parser->stack)) || (lstack_top(&parser->stack) != LJSON_IN_VAL_OBJECT))
+                {
+                    return LJSON_TYPE_OBJECT_R;
+                }
+
+                res = parser->callback(LJSON_TYPE_OBJECT_R, 0, 0, parser->user);
+                if (res != LJSON_ERROR_NONE)
+                {
+                    return _ljson_parser_stop(parser, buffer, cp + 1, res);
+                }
+                lstack_pop(&parser->stack);
+                parser->state = LJSON_AWAIT_COMMA;
+                break;
+            }
+            return LJSON_ERROR_KEY_L;
+            /* break; */
+        case LJSON_AWAIT_COLON: /* ':' */
+            if (*cp == ':')
+            {
+                parser->state = LJSON_AWAIT_VALUE;
+                break;
+            }
+            return LJSON_ERROR_COLON_L;
+            /* break; */
+        case LJSON_AWAIT_VALUE: /* '{', '[', ']', '"', other */
+            if (parser->raw && (*cp == ']'))
+            {
+                /* no items in an array of text */
+                parser->raw = 0;
+            }
+            if (parser->raw)
+            {
+                /* the whole value as text */
+                parser->raw = 0;
+                parser->raw_level = 0;
+                raw = cp;
+                if ((*cp == '{') || (*cp == '['))
+                {
+                    parser->raw_level = 1;
+                    parser->state = LJSON_IN_RAW;
+                    break;
+                }
+                if (*cp == '"')
+                {
+                    parser->state = LJSON_IN_RAW_STRING;
+                    break;
+                }
+                cp--;
+                parser->state = LJSON_IN_RAW_TOKEN;
+                break;
+            }
+            if (*cp == '{')
+            {
+                res = parser->callback(LJSON_TYPE_OBJECT_L, 0, 0, parser->user);
+                if (res != LJSON_ERROR_NONE)
+                {
+                    return _ljson_parser_stop(parser, buffer, cp + 1, res);
+                }
+                if (lstack_free(&parser->stack) < SIZE_OF_STACK_TYPE)
+                {
+                    return LJSON_ERROR_STACK_OVER;
+                }
+                lstack_push(&parser->stack, LJSON_IN_VAL_OBJECT);
+                parser->state = LJSON_AWAIT_KEY;
+                break;
+            }
+            if (*cp == '[')
+            {
+                res = parser->callback(LJSON_TYPE_ARRAY_L, 0, 0, parser->user);
+                if ((res != LJSON_ERROR_NONE) && (res != LJSON_ERROR_RAW))
+                {
+                    return _ljson_parser_stop(parser, buffer, cp + 1, res);
+                }
+                if (lstack_free(&parser->stack) < SIZE_OF_STACK_TYPE)
+                {
+                    return LJSON_ERROR_STACK_OVER;
+                }
+                /* LJSON_ERROR_RAW: every item as text */
+                lstack_push(&parser->stack, (res == LJSON_ERROR_RAW) ? LJSON_IN_VAL_RAW_ARRAY : LJSON_IN_VAL_ARRAY);
+                parser->raw = (res == LJSON_ERROR_RAW);
+                parser->state = LJSON_AWAIT_VALUE;
+                break;
+            }
+            if (*cp == ']')
+            {
+                if ((lstack_is_empty(&parser->stack))
+                    || ((lstack_top(&parser->stack) != LJSON_IN_VAL_ARRAY) && (lstack_top(&parser->stack) != LJSON_IN_VAL_RAW_ARRAY)))
+                {
+                    return LJSON_ERROR_ARRAY_R;
+                }
+
+                res = parser->callback(LJSON_TYPE_ARRAY_R, 0, 0, parser->user);
+                if (res != LJSON_ERROR_NONE)
+                {
+                    return _ljson_parser_stop(parser, buffer, cp + 1, res);
+                }
+                lstack_pop(&parser->stack);
+                parser->state = LJSON_AWAIT_COMMA;
+                break;
+            }
+            if (*cp == '"')
+            {
+                if (lstack_free(&parser->stack) < SIZE_OF_STACK_TYPE)
+                {
+                    return LJSON_ERROR_STACK_OVER;
+                }
+                lstack_push(&parser->stack, LJSON_IN_VAL_STRING);
+                parser->pval = parser->parser_buffer;
+                parser->hash = LJSON_HASH_INIT;
+                parser->state = LJSON_IN_STRING;
+                break;
+            }
+
+            parser->pval = parser->parser_buffer;
+            cp--;
+            parser->state = LJSON_IN_VAL_TOKEN;
+            break;
+        case LJSON_IN_VAL_TOKEN: /* '}', ']', ',' */
+            if ((*cp == '}') || (*cp == ']') || (*cp == ','))
+            {
+                *parser->pval = '\0';
+                res = parser->callback(LJSON_TYPE_TOKEN, parser->parser_buffer, parser->pval - parser->parser_buffer, parser->user);
+                if (res != LJSON_ERROR_NONE)
+                {
+                    return _ljson_parser_stop(parser, buffer, cp, res);
+                }
+                cp--;
+                parser->state = LJSON_AWAIT_COMMA;
+                break;
+            }
+
+            if (parser->pval >= parser->parser_buffer + LJSON_BUFFER_SIZE - 1)
+            {
+                return LJSON_ERROR_BUFFER_OVER;
+            }
+            *parser->pval++ = *cp;
+            break;
+        case LJSON_AWAIT_COMMA: /* '}', ']', ',' */
+            if (*cp == '}')
+            {
+                cp--;
+                parser->state = LJSON_AWAIT_KEY;
+                break;
+            }
+            if (*cp == ']')
+            {
+                cp--;
+                parser->state = LJSON_AWAIT_VALUE;
+                break;
+            }
+            if (*cp == ',')
+            {
+                if (lstack_is_empty(&parser->stack))
+                {
+                    return LJSON_ERROR_COMMA_R;
+                }
+                switch (lstack_top(&parser->stack))
+                {
+                case LJSON_IN_VAL_OBJECT:
+                    parser->state = LJSON_AWAIT_KEY;
+                    break;
+                case LJSON_IN_VAL_ARRAY:
+                    parser->state = LJSON_AWAIT_VALUE;
+                    break;
+                case LJSON_IN_VAL_RAW_ARRAY:
+                    parser->raw = 1;
+                    parser->state = LJSON_AWAIT_VALUE;
+                    break;
+                default:
+                    return LJSON_ERROR_COMMA_R;
+                }
+                break;
+            }
+            break;
+        case LJSON_IN_STRING: /* '"', '\\' */
+            if (*cp == '"')
+            {
+                if (lstack_is_empty(&parser->stack))
+                {
+                    return LJSON_ERROR_STRING_R;
+                }
+                switch (lstack_pop(&parser->stack))
+                {
+                case LJSON_IN_KEY:
+                    *parser->pval = '\0';
+                    if (parser->dict != 0)
+                    {
+                        res = parser->callback(LJSON_TYPE_KEY_ID, parser->parser_buffer,
+                            ljson_dict_find(parser->dict, parser->hash, parser->parser_buffer, parser->pval - parser->parser_buffer), parser->user);
+                    }
+                    else
+                    {
+                        res = parser->callback(LJSON_TYPE_KEY, parser->parser_buffer, parser->pval - parser->parser_buffer, parser->user);
+                    }
+                    if (res == LJSON_ERROR_RAW)
+                    {
+                        parser->raw = 1;
+                    }
+                    else if (res != LJSON_ERROR_NONE)
+                    {
+                        return _ljson_parser_stop(parser, buffer, cp + 1, res);
+                    }
+                    parser->state = LJSON_AWAIT_COLON;
+                    break;
+                case LJSON_IN_VAL_STRING:
+                    *parser->pval = '\0';
+                    res = parser->callback(LJSON_TYPE_STRING, parser->parser_buffer, parser->pval - parser->parser_buffer, parser->user);
+                    if (res != LJSON_ERROR_NONE)
+                    {
+                        return _ljson_parser_stop(parser, buffer, cp + 1, res);
+                    }
+                    parser->state = LJSON_AWAIT_COMMA;
+                    break;
+                default:
+                    return LJSON_ERROR_STRING_R;
+                }
                 break;
             }
-            return LJSON_ERROR_KEY_L;
-            /* break; */
-        case LJSON_AWAIT_COLON: /* ':' */
-            if (*cp == ':')
+            if (parser->pval >= parser->parser_buffer + LJSON_BUFFER_SIZE - 1)
             {
-                parser->state = LJSON_AWAIT_VALUE;
+                return LJSON_ERROR_BUFFER_OVER;
+            }
+            if (*cp == '\\')
+            {
+                parser->state = LJSON_IN_STR_ESCAPE;
                 break;
             }
-            return LJSON_ERROR_COLON_L;
-            /* break; */
-        case LJSON_AWAIT_VALUE: /* '{', '[', ']', '"', other */
-            if (*cp == '{')
+            if (parser->dict != 0)
             {
-                res = parser->callback(LJSON_TYPE_OBJECT_L, 0, 0, parser->user);
-                if (res != LJSON_ERROR_NONE)
-                {
-                    return res;
-                }
-                if (lstack_free(&parser->stack) < SIZE_OF_STACK_TYPE)
+                parser->hash = ljson_hash_step(parser->hash, *cp);
+            }
+            *parser->pval++ = *cp;
+            break;
+        case LJSON_IN_STR_ESCAPE: /* \b \f \n \r \t \u1234 */
+            switch (*cp)
+            {
+            case 'b':
+                *parser->pval++ = '\b';
+                break;
+            case 'f':
+                *parser->pval++ = '\f';
+                break;
+            case 'n':
+                *parser->pval++ = '\n';
+                break;
+            case 'r':
+                *parser->pval++ = '\r';
+                break;
+            case 't':
+                *parser->pval++ = '\t';
+                break;
+            case 'u': /* four-hex-digits, \u1234  */
+                if (parser->pval + 1 >= parser->parser_buffer + LJSON_BUFFER_SIZE - 1)
                 {
-                    return LJSON_ERROR_STACK_OVER;
+                    return LJSON_ERROR_BUFFER_OVER;
                 }
-                lstack_push(&parser->stack, LJSON_IN_VAL_OBJECT);
-                parser->state = LJSON_AWAIT_KEY;
+                cp++;
+                /* will truncate values above 0xFF */
+                cp += hex_to_num(cp, parser->pval, 1, 4);
+                parser->pval += 1;
+                cp--;
+                break;
+            default: /* handles double quote and solidus */
+                *parser->pval++ = *cp;
                 break;
             }
-            if (*cp == '[')
+            if (parser->dict != 0)
             {
-                res = parser->callback(LJSON_TYPE_ARRAY_L, 0, 0, parser->user);
-                if (res != LJSON_ERROR_NONE)
-                {
-                    return res;
-                }
-                if (lstack_free(&parser->stack) < SIZE_OF_STACK_TYPE)
-                {
-                    return LJSON_ERROR_STACK_OVER;
-                }
-                lstack_push(&parser->stack, LJSON_IN_VAL_ARRAY);
-                parser->state = LJSON_AWAIT_VALUE;
+                parser->hash = ljson_hash_step(parser->hash, parser->pval[-1]);
+            }
+            parser->state = LJSON_IN_STRING;
+            break;
+        case LJSON_IN_RAW: /* '{', '[', '"', '}', ']' */
+            if (*cp == '"')
+            {
+                parser->state = LJSON_IN_RAW_STRING;
                 break;
             }
-            if (*cp == ']')
+            if ((*cp == '{') || (*cp == '['))
             {
-                if ((lstack_is_empty(&parser->stack)) || (lstack_top(&parser->stack) != LJSON_IN_VAL_ARRAY))
-                {
-                    return LJSON_ERROR_ARRAY_R;
-                }
-
-                res = parser->callback(LJSON_TYPE_ARRAY_R, 0, 0, parser->user);
+                parser->raw_level++;
+                break;
+            }
+            if (((*cp == '}') || (*cp == ']')) && (--parser->raw_level == 0))
+            {
+                res = _ljson_parser_raw(parser, raw, cp + 1, 1);
                 if (res != LJSON_ERROR_NONE)
                 {
-                    return res;
+                    return _ljson_parser_stop(parser, buffer, cp + 1, res);
                 }
-                lstack_pop(&parser->stack);
-                parser->state = LJSON_AWAIT_COMMA;
+                raw = 0;
+            }
+            break;
+        case LJSON_IN_RAW_STRING: /* '"', '\\' */
+            if (*cp == '\\')
+            {
+                parser->state = LJSON_IN_RAW_ESCAPE;
                 break;
             }
             if (*cp == '"')
             {
-                if (lstack_free(&parser->stack) < SIZE_OF_STACK_TYPE)
+                if (parser->raw_level > 0)
                 {
-                    return LJSON_ERROR_STACK_OVER;
+                    parser->state = LJSON_IN_RAW;
+                    break;
                 }
-                lstack_push(&parser->stack, LJSON_IN_VAL_STRING);
-                parser->pval = parser->parser_buffer;
-                parser->state = LJSON_IN_STRING;
-                break;
+                res = _ljson_parser_raw(parser, raw, cp + 1, 1);
+                if (res != LJSON_ERROR_NONE)
+                {
+                    return _ljson_parser_stop(parser, buffer, cp + 1, res);
+                }
+                raw = 0;
             }
-
-            parser->pval = parser->parser_buffer;
-            cp--;
-            parser->state = LJSON_IN_VAL_TOKEN;
             break;
-        case LJSON_IN_VAL_TOKEN: /* '}', ']', ',' */
+        case LJSON_IN_RAW_ESCAPE:
+            parser->state = LJSON_IN_RAW_STRING;
+            break;
+        case LJSON_IN_RAW_TOKEN: /* '}', ']', ',' */
             if ((*cp == '}') || (*cp == ']') || (*cp == ','))
             {
-                *parser->pval = '\0';
-                res = parser->callback(LJSON_TYPE_TOKEN, parser->parser_buffer, parser->pval - parser->parser_buffer, parser->user);
+                res = _ljson_parser_raw(parser, raw, cp, 1);
                 if (res != LJSON_ERROR_NONE)
                 {
-                    return res;
+                    return _ljson_parser_stop(parser, buffer, cp, res);
                 }
+                raw = 0;
                 cp--;
-                parser->state = LJSON_AWAIT_COMMA;
-                break;
             }
+            break;
+        }
+    }
+
+    if (raw != 0)
+    {
+        /* the value goes on in the next buffer */
+        res = _ljson_parser_raw(parser, raw, eob, 0);
+        if (res != LJSON_ERROR_NONE)
+        {
+            return _ljson_parser_stop(parser, buffer, eob, res);
+        }
+    }
+
+    if (!lstack_is_empty(&parser->stack))
+    {
+        return LJSON_ERROR_MORE;
+    }
+
+    return LJSON_ERROR_NONE;
+}
+
+/* ljson_flush_t feeding the parser at user, LJSON_ERROR_MORE until the document is complete */
+uint8_t ljson_parser_flush(const void *buffer, uint16_t length, void *user)
+{
+    return ljson_parser_feed((ljson_parser_t *)user, buffer, length);
+}
+
+/* after an item is bound, hand a finished LJSON_ITEM_STREAM item to the hook */
+static uint8_t _ljson_contex_done(ljson_contex_t *contex)
+{
+    const ljson_inst_t *inst_top;
+    uint32_t index;
+
+    if ((contex->level == 0) || (contex->hook == 0))
+    {
+        return LJSON_ERROR_NONE;
+    }
+    inst_top = ljson_contex_top(contex);
+    if (inst_top->type != LJSON_ITEM_STREAM)
+    {
+        return LJSON_ERROR_NONE;
+    }
+    index = contex->ljson_item_index - 1;
+
+    return contex->hook(contex, index, (uint16_t)(index % inst_top->length));
+}
+
+/* item bound, LJSON_ERROR_DONE once every wanted item is */
+static uint8_t _ljson_contex_fill(ljson_contex_t *contex, uint16_t item)
+{
+    if (contex->schema->inst[item].flag & LJSON_INST_CASE)
+    {
+        /* the union is bound, whichever its case */
+        item = contex->schema->inst[item].parent;
+    }
+    if ((contex->mask == 0) || ljson_mask_get(contex->mask, item))
+    {
+        return LJSON_ERROR_NONE;
+    }
+    ljson_mask_set(contex->mask, item);
+    if ((contex->want != 0) && ljson_mask_get(contex->want, item) && (--contex->ljson_item_want == 0))
+    {
+        return LJSON_ERROR_DONE;
+    }
+
+    return LJSON_ERROR_NONE;
+}
+
+/* text of a LJSON_ITEM_UNION body met before its tag */
+static uint8_t _ljson_contex_capture(ljson_contex_t *contex, const uint8_t *buffer, uint16_t length)
+{
+    uint8_t *raw;
+
+    if (contex->arena == 0)
+    {
+        return LJSON_ERROR_ARENA_OVER;
+    }
+    raw = (uint8_t *)ljson_arena_realloc(contex->arena, contex->ljson_raw_buffer, contex->ljson_raw_length, contex->ljson_raw_length + length);
+    if (raw == 0)
+    {
+        return LJSON_ERROR_ARENA_OVER;
+    }
+    memcpy(raw + contex->ljson_raw_length, buffer, length);
+    contex->ljson_raw_buffer = raw;
+    contex->ljson_raw_length += length;
+
+    return LJSON_ERROR_NONE;
+}
+
+/* piece of the text of a LJSON_ITEM_RAW value */
+static uint8_t _ljson_contex_raw(ljson_contex_t *contex, uint8_t type, const uint8_t *buffer, uint16_t length)
+{
+    const ljson_inst_t *inst = ljson_contex_inst(contex);
+    uint8_t *item_buffer = ljson_contex_buffer(contex);
+    ljson_raw_t *raw = (ljson_raw_t *)item_buffer;
+    ljson_arena_t *arena = contex->arena;
+    uint8_t *copy;
+    uint16_t used;
+
+    if (inst->length > 0)
+    {
+        used = (uint16_t)strlen((const char *)item_buffer);
+        if (used + length >= inst->length)
+        {
+#ifdef LJSON_ERROR_STRING_OVER_IGNORE
+            length = inst->length - 1 - used;
+#else
+            return LJSON_ERROR_STRING_OVER;
+#endif
+        }
+        memcpy(item_buffer + used, buffer, length);
+        item_buffer[used + length] = '\0';
+        return LJSON_ERROR_NONE;
+    }
+    if ((raw->length == 0) && (type == LJSON_TYPE_RAW_END))
+    {
+        /* no copy while the text is in one piece of input */
+        raw->buffer = (const char *)buffer;
+        raw->length = length;
+        return LJSON_ERROR_NONE;
+    }
+    if (arena == 0)
+    {
+        return LJSON_ERROR_ARENA_OVER;
+    }
+    /* input goes with its feed, so the pieces are gathered in arena */
+    copy = (uint8_t *)ljson_arena_realloc(arena, (void *)raw->buffer, raw->length, raw->length + length);
+    if (copy == 0)
+    {
+        return LJSON_ERROR_ARENA_OVER;
+    }
+    memcpy(copy + raw->length, buffer, length);
+    raw->buffer = (const char *)copy;
+    raw->length += length;
+
+    return LJSON_ERROR_NONE;
+}
+
+/* first piece of a LJSON_ITEM_RAW item of the array on the top, its slot made ready */
+static uint8_t _ljson_contex_raw_item(ljson_contex_t *contex)
+{
+    const ljson_inst_t *inst = ljson_contex_inst(contex);
+    uint8_t res;
+
+    if (_ljson_contex_over(contex))
+    {
+#ifdef LJSON_ERROR_ARRAY_OVER_IGNORE
+        /* the rest of the array is skipped */
+        contex->ljson_item = LJSON_INST_NONE;
+        return LJSON_ERROR_NONE;
+#else
+        return LJSON_ERROR_ARRAY_OVER;
+#endif
+    }
+    if (ljson_contex_top(contex)->type == LJSON_ITEM_VECTOR)
+    {
+        res = _ljson_contex_reserve(contex);
+        if (res != LJSON_ERROR_NONE)
+        {
+            return res;
+        }
+    }
+    memset(ljson_contex_buffer(contex), 0, (inst->length > 0) ? inst->length : sizeof(ljson_raw_t));
+    contex->stack[contex->level - 1].flag |= LJSON_FRAME_RAW;
+
+    return LJSON_ERROR_NONE;
+}
+
+/* bind the text of a value to item through a parser of its own */
+static uint8_t _ljson_contex_replay(ljson_contex_t *contex, uint16_t item, const uint8_t *buffer, uint32_t length)
+{
+    ljson_parser_t parser;
+    uint32_t index = contex->ljson_item_index;
+    uint16_t size;
+    uint8_t res = LJSON_ERROR_NONE;
+
+    contex->ljson_item = item;
+    ljson_parser_init(&parser, ljson_callback_default, contex);
+    while (length > 0)
+    {
+        size = (length > 0xFFFF) ? 0xFFFF : (uint16_t)length;
+        res = ljson_parser_feed(&parser, buffer, size);
+        if ((res != LJSON_ERROR_NONE) && (res != LJSON_ERROR_MORE))
+        {
+            return res;
+        }
+        buffer += size;
+        length -= size;
+    }
+    if (parser.state == LJSON_IN_VAL_TOKEN)
+    {
+        /* a scalar body, nothing after it to end the token */
+        *parser.pval = '\0';
+        res = ljson_callback_default(LJSON_TYPE_TOKEN, parser.parser_buffer, (uint16_t)(parser.pval - parser.parser_buffer), contex);
+        if (res != LJSON_ERROR_NONE)
+        {
+            return res;
+        }
+    }
+    contex->ljson_item_index = index;
+
+    return res;
+}
+
+/* tag bound, bind the captured body to its case */
+static uint8_t _ljson_contex_union(ljson_contex_t *contex)
+{
+    uint16_t item = _ljson_contex_select(contex, contex->ljson_raw_item);
+
+    contex->ljson_raw_item = LJSON_INST_NONE;
+    if (item == LJSON_INST_NONE)
+    {
+#ifdef LJSON_ERROR_ITEM_MISS_IGNORE
+        return LJSON_ERROR_NONE;
+#else
+        return LJSON_ERROR_ITEM_TAG;
+#endif
+    }
+
+    return _ljson_contex_replay(contex, item, contex->ljson_raw_buffer, contex->ljson_raw_length);
+}
+
+/* text of a LJSON_INST_FIXED container, bound only if its hash changed */
+static uint8_t _ljson_contex_print(ljson_contex_t *contex, uint8_t type, const uint8_t *buffer, uint16_t length)
+{
+    uint16_t item = contex->ljson_item;
+    const uint8_t *text = buffer;
+    uint32_t size = length;
+    uint8_t *copy;
+    uint16_t i;
+    uint8_t res;
+
+    for (i = 0; i < length; i++)
+    {
+        contex->ljson_print_hash = ljson_hash_step(contex->ljson_print_hash, buffer[i]);
+    }
+    if ((type == LJSON_TYPE_RAW) || (contex->ljson_print_length > 0))
+    {
+        /* input goes with its feed, keep the text for the replay */
+        if (contex->arena == 0)
+        {
+            return LJSON_ERROR_ARENA_OVER;
+        }
+        copy = (uint8_t *)ljson_arena_realloc(contex->arena, contex->ljson_print_buffer, contex->ljson_print_length, contex->ljson_print_length + length);
+        if (copy == 0)
+        {
+            return LJSON_ERROR_ARENA_OVER;
+        }
+        memcpy(copy + contex->ljson_print_length, buffer, length);
+        contex->ljson_print_buffer = copy;
+        contex->ljson_print_length += length;
+        if (type == LJSON_TYPE_RAW)
+        {
+            return LJSON_ERROR_NONE;
+        }
+        text = copy;
+        size = contex->ljson_print_length;
+    }
+    if (contex->print[item] == contex->ljson_print_hash)
+    {
+        _ljson_contex_step(contex);
+        return _ljson_contex_fill(contex, item);
+    }
+    contex->print[item] = contex->ljson_print_hash;
+    ljson_mask_set(contex->change, item);
+    res = _ljson_contex_replay(contex, item, text, size);
+    if (res != LJSON_ERROR_NONE)
+    {
+        return res;
+    }
+    _ljson_contex_step(contex);
 
-            if (parser->pval >= parser->parser_buffer + LJSON_BUFFER_SIZE - 1)
-            {
-                return LJSON_ERROR_BUFFER_OVER;
-            }
-            *parser->pval++ = *cp;
-            break;
-        case LJSON_AWAIT_COMMA: /* '}', ']', ',' */
-            if (*cp == '}')
-            {
-                cp--;
-                parser->state = LJSON_AWAIT_KEY;
-                break;
-            }
-            if (*cp == ']')
-            {
-                cp--;
-                parser->state = LJSON_AWAIT_VALUE;
-                break;
-            }
-            if (*cp == ',')
-            {
-                if (lstack_is_empty(&parser->stack))
-                {
-                    return LJSON_ERROR_COMMA_R;
-                }
-                switch (lstack_top(&parser->stack))
-                {
-                case LJSON_IN_VAL_OBJECT:
-                    parser->state = LJSON_AWAIT_KEY;
-                    break;
-                case LJSON_IN_VAL_ARRAY:
-                    parser->state = LJSON_AWAIT_VALUE;
-                    break;
-                default:
-                    return LJSON_ERROR_COMMA_R;
-                }
-                break;
-            }
-            break;
-        case LJSON_IN_STRING: /* '"', '\\' */
-            if (*cp == '"')
-            {
-                if (lstack_is_empty(&parser->stack))
-                {
-                    return LJSON_ERROR_STRING_R;
-                }
-                switch (lstack_pop(&parser->stack))
-                {
-                case LJSON_IN_KEY:
-                    *parser->pval = '\0';
-                    res = parser->callback(LJSON_TYPE_KEY, parser->parser_buffer, parser->pval - parser->parser_buffer, parser->user);
-                    if (res != LJSON_ERROR_NONE)
-                    {
-                        return res;
-                    }
-                    parser->state = LJSON_AWAIT_COLON;
-                    break;
-                case LJSON_IN_VAL_STRING:
-                    *parser->pval = '\0';
-                    res = parser->callback(LJSON_TYPE_STRING, parser->parser_buffer, parser->pval - parser->parser_buffer, parser->user);
-                    if (res != LJSON_ERROR_NONE)
-                    {
-                        return res;
-                    }
-                    parser->state = LJSON_AWAIT_COMMA;
-                    break;
-                default:
-                    return LJSON_ERROR_STRING_R;
-                }
-                break;
-            }
-            if (parser->pval >= parser->parser_buffer + LJSON_BUFFER_SIZE - 1)
-            {
-                return LJSON_ERROR_BUFFER_OVER;
-            }
-            if (*cp == '\\')
+    return LJSON_ERROR_NONE;
+}
+
+/* value of inst bound, or left as it was */
+static uint8_t _ljson_contex_bound(ljson_contex_t *contex, const ljson_inst_t *inst)
+{
+    uint8_t res;
+
+    _ljson_contex_step(contex);
+    if (inst->flag & LJSON_INST_TAG)
+    {
+        contex->stack[contex->level - 1].flag |= LJSON_FRAME_TAG;
+        if ((contex->ljson_raw_item != LJSON_INST_NONE) && (contex->ljson_raw_level == contex->level))
+        {
+            res = _ljson_contex_union(contex);
+            if (res != LJSON_ERROR_NONE)
             {
-                parser->state = LJSON_IN_STR_ESCAPE;
-                break;
+                return res;
             }
-            *parser->pval++ = *cp;
+        }
+    }
+    res = _ljson_contex_done(contex);
+    if (res != LJSON_ERROR_NONE)
+    {
+        return res;
+    }
+
+    return _ljson_contex_fill(contex, (uint16_t)(inst - contex->schema->inst));
+}
+
+/* key of the object on the top, the item it names made current */
+static uint8_t _ljson_contex_key(ljson_contex_t *contex, const uint8_t *buffer, uint16_t length)
+{
+    const ljson_inst_t *inst;
+    const ljson_inst_t *inst_top;
+    uint32_t hash;
+    uint16_t i;
+
+    if (contex->ljson_item_miss > 0)
+    {
+        return LJSON_ERROR_NONE;
+    }
+    /* inst_top must be LJSON_ITEM_OBJECT */
+    inst_top = ljson_contex_top(contex);
+    hash = ljson_hash(buffer, length);
+    for (i = 0; i < inst_top->length; i++)
+    {
+        if (contex->ljson_item_index >= inst_top->length)
+        {
+            contex->ljson_item_index = 0;
+        }
+        inst = &contex->schema->inst[inst_top->child + contex->ljson_item_index];
+        if (inst->name == 0)
+        {
+            return LJSON_ERROR_ITEM_NAME;
+        }
+        if ((inst->hash == hash) && (memcmp(inst->name, buffer, length + 1) == 0))
+        {
             break;
-        case LJSON_IN_STR_ESCAPE: /* \b \f \n \r \t \u1234 */
-            switch (*cp)
+        }
+        contex->ljson_item_index++;
+    }
+    if (i >= inst_top->length)
+    {
+        contex->ljson_item = LJSON_INST_NONE;
+#ifdef LJSON_ERROR_ITEM_MISS_IGNORE
+        return LJSON_ERROR_NONE;
+#else
+        return LJSON_ERROR_ITEM_MISS;
+#endif
+    }
+    contex->ljson_item = inst_top->child + contex->ljson_item_index;
+    if (inst->type == LJSON_ITEM_UNION)
+    {
+        if (contex->stack[contex->level - 1].flag & LJSON_FRAME_TAG)
+        {
+            contex->ljson_item = _ljson_contex_select(contex, contex->ljson_item);
+            if (contex->ljson_item == LJSON_INST_NONE)
             {
-            case 'b':
-                *parser->pval++ = '\b';
-                break;
-            case 'f':
-                *parser->pval++ = '\f';
-                break;
-            case 'n':
-                *parser->pval++ = '\n';
-                break;
-            case 'r':
-                *parser->pval++ = '\r';
-                break;
-            case 't':
-                *parser->pval++ = '\t';
-                break;
-            case 'u': /* four-hex-digits, \u1234  */
-                if (parser->pval + 1 >= parser->parser_buffer + LJSON_BUFFER_SIZE - 1)
-                {
-                    return LJSON_ERROR_BUFFER_OVER;
-                }
-                cp++;
-                /* will truncate values above 0xFF */
-                cp += hex_to_num(cp, parser->pval, 1, 4);
-                parser->pval += 1;
-                cp--;
-                break;
-            default: /* handles double quote and solidus */
-                *parser->pval++ = *cp;
-                break;
+#ifdef LJSON_ERROR_ITEM_MISS_IGNORE
+                return LJSON_ERROR_NONE;
+#else
+                return LJSON_ERROR_ITEM_TAG;
+#endif
             }
-            parser->state = LJSON_IN_STRING;
-            break;
+            return LJSON_ERROR_NONE;
+        }
+        /* tag comes later, capture the body */
+        if (contex->ljson_raw_item != LJSON_INST_NONE)
+        {
+            return LJSON_ERROR_ITEM_TAG;
         }
+        contex->ljson_raw_buffer = 0;
+        contex->ljson_raw_length = 0;
+        return LJSON_ERROR_RAW;
     }
-
-    if (!lstack_is_empty(&parser->stack))
+    if ((inst->type == LJSON_ITEM_RAW) && ((inst->buffer != 0) || (contex->base != 0)))
     {
-        return LJSON_ERROR_MORE;
+        memset(ljson_contex_buffer(contex), 0, (inst->length > 0) ? inst->length : sizeof(ljson_raw_t));
+        return LJSON_ERROR_RAW;
+    }
+    if ((contex->print != 0) && (inst->flag & LJSON_INST_FIXED)
+        && ((inst->type == LJSON_ITEM_OBJECT) || (inst->type == LJSON_ITEM_ARRAY) || (inst->type == LJSON_ITEM_VECTOR)))
+    {
+        /* hash the text first */
+        contex->ljson_print_buffer = 0;
+        contex->ljson_print_length = 0;
+        contex->ljson_print_hash = LJSON_HASH_INIT;
+        return LJSON_ERROR_RAW;
     }
 
     return LJSON_ERROR_NONE;
@@ -954,106 +3296,217 @@ uint8_t ljson_callback_default(uint8_t type, uint8_t *buffer, uint16_t length, v
 
     uint16_t i;
     uint8_t res;
-    ljson_item_t *item_top;
+    uint32_t hash;
+    const ljson_inst_t *inst;
+    const ljson_inst_t *inst_top;
     uint8_t *item_buffer;
 
     switch (type)
     {
     case LJSON_TYPE_OBJECT_L:
     case LJSON_TYPE_ARRAY_L:
+        if ((contex->ljson_item != LJSON_INST_NONE) && (contex->level > 0))
+        {
+            switch (ljson_contex_top(contex)->type)
+            {
+            case LJSON_ITEM_VECTOR:
+                res = _ljson_contex_reserve(contex);
+                if (res != LJSON_ERROR_NONE)
+                {
+                    return res;
+                }
+                break;
+            case LJSON_ITEM_STREAM:
+                /* slot of an earlier item */
+                _ljson_contex_reset(contex);
+                break;
+            default:
+                break;
+            }
+        }
+        if ((contex->mode & LJSON_MODE_PATCH) && (type == LJSON_TYPE_ARRAY_L) && (contex->ljson_item != LJSON_INST_NONE)
+            && (contex->ljson_item_miss == 0) && (ljson_contex_inst(contex)->type != LJSON_ITEM_STREAM))
+        {
+            /* replaced, not merged */
+            _ljson_contex_reset(contex);
+        }
         res = ljson_contex_push(contex, type);
         if (res != LJSON_ERROR_NONE)
         {
             return res;
         }
-        if (type == LJSON_TYPE_ARRAY_L)
+        if ((type == LJSON_TYPE_ARRAY_L) && (contex->ljson_item_miss == 0))
         {
-            lstack_top_buffer(&contex->stack, &item_top, sizeof(item_top));
-            contex->ljson_item = (ljson_item_t *)item_top->buffer;
+            inst_top = ljson_contex_top(contex);
+            contex->ljson_item = inst_top->child;
+            if (inst_top->type == LJSON_ITEM_VECTOR)
+            {
+                ((ljson_vector_t *)_ljson_contex_field(contex))->count = 0;
+            }
+            inst = ljson_contex_inst(contex);
+            if ((inst->type == LJSON_ITEM_RAW) && ((inst->buffer != 0) || (contex->base != 0) || (inst_top->type == LJSON_ITEM_VECTOR)))
+            {
+                /* the items come as text */
+                return LJSON_ERROR_RAW;
+            }
         }
         break;
     case LJSON_TYPE_OBJECT_R:
     case LJSON_TYPE_ARRAY_R:
+        if ((contex->ljson_item_miss == 0) && (contex->level > 0))
+        {
+            if ((contex->ljson_raw_item != LJSON_INST_NONE) && (contex->ljson_raw_level == contex->level))
+            {
+                /* no tag for the body */
+                contex->ljson_raw_item = LJSON_INST_NONE;
+#ifndef LJSON_ERROR_ITEM_MISS_IGNORE
+                return LJSON_ERROR_ITEM_TAG;
+#endif
+            }
+            inst_top = ljson_contex_top(contex);
+            if ((inst_top->type == LJSON_ITEM_ARRAY) && (inst_top->buffer != 0))
+            {
+                *(uint32_t *)_ljson_contex_field(contex) = ((inst_top->length > 0) && (contex->ljson_item_index > inst_top->length)) ? inst_top->length : contex->ljson_item_index;
+            }
+            else if ((inst_top->type == LJSON_ITEM_STREAM) && (inst_top->buffer != 0))
+            {
+                *(uint32_t *)_ljson_contex_field(contex) = contex->ljson_item_index;
+            }
+            res = ljson_contex_pop(contex, type);
+            if (res != LJSON_ERROR_NONE)
+            {
+                return res;
+            }
+            res = _ljson_contex_done(contex);
+            if (res != LJSON_ERROR_NONE)
+            {
+                return res;
+            }
+            return _ljson_contex_fill(contex, contex->ljson_item);
+        }
         res = ljson_contex_pop(contex, type);
         if (res != LJSON_ERROR_NONE)
         {
             return res;
         }
         break;
+    case LJSON_TYPE_KEY_ID:
+        /* ids are for callbacks of their own, the key is matched by its text */
+        return _ljson_contex_key(contex, buffer, (uint16_t)strlen((const char *)buffer));
     case LJSON_TYPE_KEY:
-        if (contex->ljson_item_miss > 0)
+        return _ljson_contex_key(contex, buffer, length);
+    case LJSON_TYPE_RAW:
+    case LJSON_TYPE_RAW_END:
+        if (contex->ljson_item == LJSON_INST_NONE)
         {
             break;
         }
-        /* item_top must be LJSON_ITEM_OBJECT */
-        lstack_top_buffer(&contex->stack, &item_top, sizeof(item_top));
-        for (i = 0; i < item_top->length; i++)
+        inst = ljson_contex_inst(contex);
+        if ((inst->type == LJSON_ITEM_RAW) && (contex->level > 0) && ljson_item_is_array(ljson_contex_top(contex)->type)
+            && !(contex->stack[contex->level - 1].flag & LJSON_FRAME_RAW))
         {
-            if (contex->ljson_item_index >= item_top->length)
-            {
-                contex->ljson_item_index = 0;
-            }
-            contex->ljson_item = &((ljson_item_t*)(item_top->buffer))[contex->ljson_item_index];
-            if (contex->ljson_item->name == 0)
+            res = _ljson_contex_raw_item(contex);
+            if ((res != LJSON_ERROR_NONE) || (contex->ljson_item == LJSON_INST_NONE))
             {
-                return LJSON_ERROR_ITEM_NAME;
-            }
-            if (memcmp(contex->ljson_item->name, buffer, length + 1) == 0)
-            {
-                break;
+                return res;
             }
-            contex->ljson_item_index++;
         }
-        if (i >= item_top->length)
+        switch (inst->type)
         {
-            contex->ljson_item = 0;
-#ifdef LJSON_ERROR_ITEM_MISS_IGNORE
+        case LJSON_ITEM_RAW:
+            res = _ljson_contex_raw(contex, type, buffer, length);
             break;
-#else
-            return LJSON_ERROR_ITEM_MISS;
-#endif
+        case LJSON_ITEM_UNION:
+            res = _ljson_contex_capture(contex, buffer, length);
+            break;
+        default:
+            return _ljson_contex_print(contex, type, buffer, length);
+        }
+        if ((res != LJSON_ERROR_NONE) || (type == LJSON_TYPE_RAW))
+        {
+            return res;
+        }
+        if (inst->type == LJSON_ITEM_RAW)
+        {
+            if (contex->level > 0)
+            {
+                contex->stack[contex->level - 1].flag &= (uint8_t)~LJSON_FRAME_RAW;
+            }
+            return _ljson_contex_bound(contex, inst);
         }
+        contex->ljson_raw_item = contex->ljson_item;
+        contex->ljson_raw_level = contex->level;
+        _ljson_contex_step(contex);
         break;
     case LJSON_TYPE_TOKEN:
     case LJSON_TYPE_STRING:
-        if (contex->ljson_item == 0)
+    case LJSON_TYPE_INTEGER:
+    case LJSON_TYPE_UNSIGNED:
+    case LJSON_TYPE_REAL:
+        if (contex->ljson_item == LJSON_INST_NONE)
         {
             /* skip key, then skip value */
             break;
         }
-        if (contex->ljson_item->buffer == 0)
-        {
-            /* skip value */
-            break;
-        }
-        lstack_top_buffer(&contex->stack, &item_top, sizeof(item_top));
-        if (item_top->type == LJSON_ITEM_ARRAY)
+        inst = ljson_contex_inst(contex);
+        if (contex->level > 0)
         {
-            if ((item_top->length > 0) && (contex->ljson_item_index >= item_top->length))
+            inst_top = ljson_contex_top(contex);
+            if (_ljson_contex_over(contex))
             {
 #ifdef LJSON_ERROR_ARRAY_OVER_IGNORE
-                contex->ljson_item = 0;
                 return LJSON_ERROR_NONE;
 #else
                 return LJSON_ERROR_ARRAY_OVER;
 #endif
             }
+            if (inst_top->type == LJSON_ITEM_VECTOR)
+            {
+                res = _ljson_contex_reserve(contex);
+                if (res != LJSON_ERROR_NONE)
+                {
+                    return res;
+                }
+            }
+        }
+        if ((contex->mode & LJSON_MODE_PATCH) && (type == LJSON_TYPE_TOKEN)
+            && ((inst->type == LJSON_ITEM_OBJECT) || ljson_item_is_array(inst->type)) && (strcmp((const char *)buffer, "null") == 0))
+        {
+            /* null removes the object or array */
+            _ljson_contex_reset(contex);
+            _ljson_contex_step(contex);
+            return _ljson_contex_done(contex);
+        }
+        if ((inst->buffer == 0) && (contex->base == 0))
+        {
+            /* skip value */
+            break;
+        }
+        if ((contex->print != 0) && (inst->flag & LJSON_INST_FIXED) && (inst->type != LJSON_ITEM_CALLBACK))
+        {
+            i = (uint16_t)(inst - contex->schema->inst);
+            hash = ljson_hash_step(ljson_hash(buffer, length), type);
+            if (contex->print[i] == hash)
+            {
+                return _ljson_contex_bound(contex, inst);
+            }
+            contex->print[i] = hash;
+            ljson_mask_set(contex->change, i);
         }
-        item_buffer = (uint8_t*)contex->ljson_item->buffer;
-        if (contex->ljson_item->type != LJSON_ITEM_CALLBACK)
+        item_buffer = ljson_contex_buffer(contex);
+        if (inst->type != LJSON_ITEM_CALLBACK)
         {
-            item_buffer += contex->ljson_array_offset;
-            memset(item_buffer, 0, contex->ljson_item->length);
+            memset(item_buffer, 0, inst->length);
         }
-        switch (contex->ljson_item->type)
+        switch (inst->type)
         {
         case LJSON_ITEM_STRING: /* "chars" null */
             if (type == LJSON_TYPE_STRING)
             {
-                if (length > contex->ljson_item->length)
+                if (length > inst->length)
                 {
 #ifdef LJSON_ERROR_STRING_OVER_IGNORE
-                    length = contex->ljson_item->length;
+                    length = inst->length;
 #else
                     return LJSON_ERROR_STRING_OVER;
 #endif
@@ -1062,13 +3515,43 @@ uint8_t ljson_callback_default(uint8_t type, uint8_t *buffer, uint16_t length, v
             }
             break;
         case LJSON_ITEM_INTEGER: /* int */
-            str_to_num(buffer, item_buffer, (uint8_t)contex->ljson_item->length, 0);
+        case LJSON_ITEM_UNSIGNED: /* unsigned int, up to 18446744073709551615 */
+            switch (type)
+            {
+            case LJSON_TYPE_INTEGER:
+            case LJSON_TYPE_UNSIGNED:
+                numcpy(item_buffer, *(const uint64_t *)buffer, (uint8_t)inst->length);
+                break;
+            case LJSON_TYPE_REAL:
+                numcpy(item_buffer, (inst->type == LJSON_ITEM_INTEGER) ? (uint64_t)(int64_t)*(const double *)buffer : (uint64_t)*(const double *)buffer, (uint8_t)inst->length);
+                break;
+            default:
+                str_to_num((const char *)buffer, item_buffer, (uint8_t)inst->length, (inst->type == LJSON_ITEM_INTEGER) ? 0 : 20);
+                break;
+            }
             break;
         case LJSON_ITEM_REAL: /* real, . e e+ e- E E+ E- */
-            str_to_exp(buffer, item_buffer, (uint8_t)contex->ljson_item->length);
+            switch (type)
+            {
+            case LJSON_TYPE_INTEGER:
+                realcpy(item_buffer, (double)*(const int64_t *)buffer, (uint8_t)inst->length);
+                break;
+            case LJSON_TYPE_UNSIGNED:
+                realcpy(item_buffer, (double)*(const uint64_t *)buffer, (uint8_t)inst->length);
+                break;
+            case LJSON_TYPE_REAL:
+                realcpy(item_buffer, *(const double *)buffer, (uint8_t)inst->length);
+                break;
+            default:
+                str_to_exp((const char *)buffer, item_buffer, (uint8_t)inst->length);
+                break;
+            }
             break;
         case LJSON_ITEM_BOOLEAN: /* true false TRUE FALSE */
-            str_to_bool(buffer, item_buffer, (uint8_t)contex->ljson_item->length);
+            if (type == LJSON_TYPE_TOKEN)
+            {
+                str_to_bool((const char *)buffer, item_buffer, (uint8_t)inst->length);
+            }
             break;
         case LJSON_ITEM_CALLBACK:
             res = ((ljson_callback_t)item_buffer)(type, buffer, length, user);
@@ -1081,12 +3564,7 @@ uint8_t ljson_callback_default(uint8_t type, uint8_t *buffer, uint16_t length, v
             return LJSON_ERROR_ITEM_TYPE;
             /* break; */
         }
-        contex->ljson_item_index++;
-        if (item_top->type == LJSON_ITEM_ARRAY)
-        {
-            contex->ljson_array_offset += item_top->offset;
-        }
-        break;
+        return _ljson_contex_bound(contex, inst);
     }
 
     return LJSON_ERROR_NONE;
@@ -2,6 +2,7 @@
 #define _LJSON_H_
 
 #include <stdint.h>
+#include <stddef.h> /* offsetof */
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,11 +15,17 @@ extern "C" {
 #define LJSON_FMT_TAB_SIZE      4       /* ljson_contex_snprintf fmt */
 
 #define SIZE_OF_STACK_TYPE      (sizeof(uint8_t))   /* for LJSON_TYPE_XXX */
-#define SIZE_OF_STACK_CONTEX    (sizeof(void *) + sizeof(uint16_t) + sizeof(uint32_t))   /* see ljson_contex_t */
 
 #define LJSON_BUFFER_SIZE       256     /* buffer (with '\0') for key, value */
 #define LJSON_TYPE_STACK_SIZE   (SIZE_OF_STACK_TYPE * 10)   /* type  for object '{', array '[', string '"' */
-#define LJSON_CONTEX_STACK_SIZE (SIZE_OF_STACK_CONTEX * 9)  /* contex for object '{', array '[' */
+#define LJSON_CONTEX_STACK_SIZE 9       /* ljson_frame_t for object '{', array '[' */
+#define LJSON_VECTOR_SIZE       4       /* first capacity of LJSON_ITEM_VECTOR, then doubled */
+#define LJSON_IOVEC_MIN         64      /* shortest text kept in place by a writer with ljson_writer_iovec */
+
+#define LJSON_INST_NONE         0xFFFF  /* ljson_contex_t.ljson_item, item miss */
+#define LJSON_KEY_NONE          0xFFFF  /* LJSON_TYPE_KEY_ID, key not in ljson_dict_t */
+
+#define LJSON_MODE_PATCH        0x01    /* ljson_contex_t.mode, RFC 7386: null resets, arrays are replaced, the rest kept */
 
 #define LJSON_TYPE_OBJECT_L     0x00    /* '{' */
 #define LJSON_TYPE_OBJECT_R     0x01    /* '}' */
@@ -27,6 +34,15 @@ extern "C" {
 #define LJSON_TYPE_KEY          0x04    /* '"' */
 #define LJSON_TYPE_TOKEN        0x05    /* */
 #define LJSON_TYPE_STRING       0x06    /* '"' */
+#define LJSON_TYPE_RAW          0x07    /* value text after LJSON_ERROR_RAW, more in the next feed */
+#define LJSON_TYPE_RAW_END      0x08    /* last of the value text, may be empty */
+#define LJSON_TYPE_KEY_ID       0x09    /* '"' with ljson_parser_t.dict, length is the id or LJSON_KEY_NONE */
+#define LJSON_TYPE_WRITE        0x0A    /* LJSON_ITEM_CALLBACK on output, buffer is the ljson_writer_t, length counts calls up to 0xFFFF, LJSON_ERROR_MORE for another */
+#define LJSON_TYPE_INTEGER      0x0B    /* binary value, buffer is an int64_t (ljson_cbor.c) */
+#define LJSON_TYPE_UNSIGNED     0x0C    /* binary value, buffer is a uint64_t */
+#define LJSON_TYPE_REAL         0x0D    /* binary value, buffer is a double */
+#define LJSON_TYPE_WRITE_CBOR   0x0E    /* as LJSON_TYPE_WRITE, one CBOR item for ljson_cbor_write */
+#define LJSON_TYPE_NONE         0xFF    /* ljson_contex_next, end of walk */
 
 #define LJSON_ITEM_OBJECT       0x00    /* struct {} */
 #define LJSON_ITEM_ARRAY        0x01    /* array [] */
@@ -35,6 +51,11 @@ extern "C" {
 #define LJSON_ITEM_REAL         0x04    /* real // . e e+ e- E E+ E- */
 #define LJSON_ITEM_BOOLEAN      0x05    /* true false TRUE FALSE */
 #define LJSON_ITEM_CALLBACK     0x06    /* ljson_callback_t callback */
+#define LJSON_ITEM_VECTOR       0x07    /* array [] in ljson_vector_t, grows from ljson_arena_t */
+#define LJSON_ITEM_STREAM       0x08    /* array [] through a ring of slots, ljson_contex_t.hook per item */
+#define LJSON_ITEM_UNION        0x09    /* one of the case items named by the value of the tag sibling */
+#define LJSON_ITEM_RAW          0x0A    /* value text as is, "chars" of length or ljson_raw_t if length is 0 */
+#define LJSON_ITEM_UNSIGNED     0x0B    /* unsigned int */
 
 #define LJSON_ERROR_NONE        0x00
 #define LJSON_ERROR_MORE        0x01
@@ -53,6 +74,14 @@ extern "C" {
 #define LJSON_ERROR_ITEM_NAME   0x0E
 #define LJSON_ERROR_ITEM_MISS   0x0F
 #define LJSON_ERROR_ITEM_TYPE   0x10
+#define LJSON_ERROR_SCHEMA_OVER 0x11
+#define LJSON_ERROR_ARENA_OVER  0x12
+#define LJSON_ERROR_RAW         0x13    /* from callback at LJSON_TYPE_KEY, the value comes as LJSON_TYPE_RAW */
+#define LJSON_ERROR_ITEM_TAG    0x14
+#define LJSON_ERROR_DONE        0x15    /* every wanted item bound, ljson_parser_t.used bytes consumed */
+#define LJSON_ERROR_THREAD      0x16    /* ljson_thread.c, a thread not started */
+#define LJSON_ERROR_CBOR        0x17    /* ljson_cbor.c, malformed or unsupported input */
+#define LJSON_ERROR_ZLIB        0x18    /* ljson_zlib.c, corrupt stream */
 
 ////////////////////////////////////////
 
@@ -65,6 +94,15 @@ typedef struct _lstack
 
 typedef uint8_t(*ljson_callback_t)(uint8_t type, uint8_t *buffer, uint16_t length, void *user);
 
+/* keys known to the callback, the id of a key is its index in name */
+typedef struct _ljson_dict
+{
+    const char *const *name;
+    uint16_t count;
+    uint16_t *slot;     /* open addressing, id + 1 or 0 */
+    uint16_t size;      /* power of 2, above count */
+} ljson_dict_t;
+
 typedef struct _ljson_parser
 {
     uint8_t state;
@@ -72,6 +110,11 @@ typedef struct _ljson_parser
     uint8_t stack_buffer[LJSON_TYPE_STACK_SIZE];
     uint8_t *pval;
     uint8_t parser_buffer[LJSON_BUFFER_SIZE];
+    uint16_t raw_level;
+    uint8_t raw;
+    uint16_t used;      /* bytes of the last ljson_parser_feed consumed, less if a callback stopped it */
+    uint32_t hash;      /* ljson_hash of the string being read */
+    const ljson_dict_t *dict;   /* keys come as LJSON_TYPE_KEY_ID */
 
     void *user;
     ljson_callback_t callback;
@@ -85,26 +128,157 @@ typedef struct _ljson_item
     uint8_t type;
     uint16_t length;
     void *buffer;
-    uint16_t offset;
+    uint32_t offset;    /* element size, member offset of an object, index of the tag sibling for LJSON_ITEM_UNION */
+    void *count;        /* uint32_t element count for LJSON_ITEM_ARRAY LJSON_ITEM_STREAM, ljson_vector_t for LJSON_ITEM_VECTOR */
 } ljson_item_t;
 
-typedef struct _ljson_contex
+typedef struct _ljson_vector
 {
-    lstack_t stack;
-    uint8_t stack_buffer[LJSON_CONTEX_STACK_SIZE];
+    void *buffer;       /* elements, ljson_item_t of the element is offset from here */
+    uint32_t count;
+    uint32_t size;      /* capacity */
+} ljson_vector_t;
+
+/* writes length bytes of a full block, or the rest at the end */
+typedef uint8_t(*ljson_flush_t)(const void *buffer, uint16_t length, void *user);
+
+/* as struct iovec */
+typedef struct _ljson_iovec
+{
+    void *iov_base;
+    size_t iov_len;
+} ljson_iovec_t;
+
+/* writes count pieces at once, as writev */
+typedef uint8_t(*ljson_flushv_t)(const ljson_iovec_t *iov, uint16_t count, void *user);
+
+typedef struct _ljson_writer
+{
+    char *buffer;       /* block */
+    uint16_t size;
+    uint16_t used;
+    uint32_t length;    /* bytes written in all */
+    ljson_flush_t flush;    /* 0: the block is the whole output, the rest only counted */
+    void *user;
+    uint8_t error;      /* from flush, sticky */
+    uint32_t call;      /* calls of LJSON_TYPE_WRITE before this one for the value, length saturates */
+
+    /* ljson_writer_iovec */
+    ljson_iovec_t *iov; /* pieces in the block or kept in place */
+    uint16_t iov_size;
+    uint16_t iov_count;
+    ljson_flushv_t flushv;
+} ljson_writer_t;
+
+typedef struct _ljson_raw
+{
+    const char *buffer; /* into the input while it lives, or into the arena */
+    uint32_t length;
+} ljson_raw_t;
+
+typedef struct _ljson_arena
+{
+    uint8_t *buffer;
+    uint32_t size;
+    uint32_t used;
+} ljson_arena_t;
+
+/* ljson_item_t tree compiled by ljson_schema_compile, children are contiguous */
+typedef struct _ljson_inst
+{
+    const char *name;
+    uint8_t *buffer;    /* field or offset from ljson_contex_t.base, ljson_callback_t for LJSON_ITEM_CALLBACK, count for array */
+    uint32_t hash;      /* ljson_hash of name */
+    uint32_t offset;    /* element size for LJSON_ITEM_ARRAY, member offset for LJSON_ITEM_OBJECT, tag for LJSON_ITEM_UNION */
+    uint16_t length;
+    uint16_t child;     /* first child for LJSON_ITEM_OBJECT, array */
+    uint16_t parent;
+    uint8_t type;
+    uint8_t flag;       /* LJSON_INST_XXX */
+} ljson_inst_t;
+
+#define LJSON_INST_KEY          0x01    /* parent is LJSON_ITEM_OBJECT */
+#define LJSON_INST_CASE         0x02    /* parent is LJSON_ITEM_UNION, name is the tag value */
+#define LJSON_INST_TAG          0x04    /* selects the case of a LJSON_ITEM_UNION sibling */
+#define LJSON_INST_FIXED        0x08    /* reached through objects only, one field per inst */
+
+typedef struct _ljson_schema
+{
+    ljson_inst_t *inst; /* inst[0] is top */
+    uint16_t count;
+    uint16_t size;
+} ljson_schema_t;
+
+/* constant text of a schema for compact output, rendered once by ljson_serializer_compile */
+typedef struct _ljson_serializer
+{
+    const ljson_schema_t *schema;
+    const char *buffer;     /* ',' "key": '{' '[' before each inst */
+    const uint16_t *offset; /* fragment of inst i is buffer[offset[i]] to buffer[offset[i + 1]] */
+} ljson_serializer_t;
 
+typedef struct _ljson_frame
+{
+    uint8_t *base;
+    uint32_t ljson_array_offset;
+    uint32_t ljson_item_index;
+    uint16_t ljson_item;
+    uint8_t flag;       /* LJSON_FRAME_XXX */
+} ljson_frame_t;
+
+#define LJSON_FRAME_TAG         0x01    /* tag bound in this object */
+#define LJSON_FRAME_RAW         0x02    /* an item of this array is coming as text */
+
+struct _ljson_contex;
+
+/* LJSON_ITEM_STREAM item done, slot (index % length) may be reused after return */
+typedef uint8_t(*ljson_hook_t)(struct _ljson_contex *contex, uint32_t index, uint16_t slot);
+
+typedef struct _ljson_contex
+{
+    ljson_frame_t stack[LJSON_CONTEX_STACK_SIZE];
+    uint8_t level;
+
+    const ljson_schema_t *schema;
+    uint8_t *base;      /* 0: ljson_item_t.buffer is address, else offset from base */
+    ljson_arena_t *arena;   /* storage for LJSON_ITEM_VECTOR, LJSON_ITEM_UNION body, LJSON_ITEM_RAW over feeds */
+    ljson_hook_t hook;      /* LJSON_ITEM_STREAM */
+    uint8_t mode;           /* LJSON_MODE_XXX */
+    const uint8_t *project; /* insts walked by ljson_contex_next, 0: all */
+    void *user;
     uint16_t ljson_item_miss;
 
+    /* ljson_contex_track */
+    uint8_t *mask;          /* inst bound, LJSON_MASK_SIZE(schema->count) */
+    const uint8_t *want;    /* inst wanted before LJSON_ERROR_DONE */
+    uint16_t ljson_item_want;
+
+    /* ljson_contex_fingerprint */
+    uint32_t *print;        /* hash of the text of each LJSON_INST_FIXED inst, kept between loads */
+    uint8_t *change;        /* inst bound as its text changed */
+    uint8_t *ljson_print_buffer;
+    uint32_t ljson_print_length;
+    uint32_t ljson_print_hash;
+
+    /* LJSON_ITEM_UNION body met before its tag, kept in arena */
+    uint8_t *ljson_raw_buffer;
+    uint32_t ljson_raw_length;
+    uint16_t ljson_raw_item;
+    uint8_t ljson_raw_level;
+
     /* push pop */
-    ljson_item_t *ljson_item;
-    uint16_t ljson_item_index;
+    uint16_t ljson_item;
+    uint32_t ljson_item_index;
     uint32_t ljson_array_offset;
+    uint8_t ljson_item_step;    /* ljson_contex_next */
 } ljson_contex_t;
 
 ////////////////////////////////////////////////////////////////////////////////
 
 #define countof(a)  (sizeof(a) / sizeof((a)[0]))
 
+#define LJSON_OFFSET(type, member)  ((void *)offsetof(type, member))    /* ljson_item_t.buffer relative to base */
+
 #define lstack_free(stack)          ((stack)->top)
 #define lstack_used(stack)          ((stack)->size - (stack)->top)
 #define lstack_is_empty(stack)      ((stack)->top >= (stack)->size)
@@ -112,6 +286,18 @@ typedef struct _ljson_contex
 #define lstack_pop(stack)           ((stack)->buffer[((stack)->top)++])
 #define lstack_top(stack)           ((stack)->buffer[(stack)->top])
 
+#define LJSON_HASH_INIT             0x811C9DC5  /* FNV-1a */
+#define ljson_hash_step(hash, ch)   (((hash) ^ (uint8_t)(ch)) * 0x01000193)
+
+#define LJSON_MASK_SIZE(count)      (((count) + 7) / 8)     /* bytes of a mask over insts */
+#define ljson_mask_get(mask, i)     ((mask)[(i) >> 3] & (1 << ((i) & 7)))
+#define ljson_mask_set(mask, i)     ((mask)[(i) >> 3] |= (uint8_t)(1 << ((i) & 7)))
+
+#define ljson_item_is_array(type)   (((type) == LJSON_ITEM_ARRAY) || ((type) == LJSON_ITEM_VECTOR) || ((type) == LJSON_ITEM_STREAM))
+
+#define ljson_contex_inst(contex)   (&(contex)->schema->inst[(contex)->ljson_item])
+#define ljson_contex_top(contex)    (&(contex)->schema->inst[(contex)->stack[(contex)->level - 1].ljson_item])
+
 ////////////////////////////////////////
 
 void lstack_init(lstack_t *stack, uint8_t *buffer, uint16_t size);
@@ -134,19 +320,70 @@ uint8_t str_to_bool(const char *str, void *num, uint8_t size);
 uint16_t snprintf_string(char *dst, uint16_t size, const void *src, uint16_t length);
 uint16_t snprintf_token(char *dst, uint16_t size, const void *src);
 uint16_t snprintf_integer(char *dst, uint16_t size, const void *src, uint16_t length);
+uint16_t snprintf_unsigned(char *dst, uint16_t size, const void *src, uint16_t length);
 uint16_t snprintf_real(char *dst, uint16_t size, const void *src, uint16_t length);
+uint16_t snprintf_raw(char *dst, uint16_t size, const void *src, uint16_t length);
 
 ////////////////////////////////////////
 
-void ljson_contex_init(ljson_contex_t *contex, const ljson_item_t *top);
+void ljson_writer_init(ljson_writer_t *writer, void *buffer, uint16_t size, ljson_flush_t flush, void *user);
+void ljson_writer_iovec(ljson_writer_t *writer, ljson_iovec_t *iov, uint16_t size, ljson_flushv_t flushv);
+uint8_t ljson_writer_write(ljson_writer_t *writer, const void *src, uint32_t length);
+uint8_t ljson_writer_reference(ljson_writer_t *writer, const void *src, uint32_t length);
+uint8_t ljson_writer_string(ljson_writer_t *writer, const void *src, uint16_t length);
+uint8_t ljson_writer_integer(ljson_writer_t *writer, int64_t value);
+uint8_t ljson_writer_real(ljson_writer_t *writer, double value);
+uint8_t ljson_writer_flush(ljson_writer_t *writer);
+
+////////////////////////////////////////
+
+void ljson_arena_init(ljson_arena_t *arena, void *buffer, uint32_t size);
+void *ljson_arena_alloc(ljson_arena_t *arena, uint32_t size);
+void *ljson_arena_realloc(ljson_arena_t *arena, void *buffer, uint32_t size, uint32_t length);
+
+////////////////////////////////////////
+
+uint32_t ljson_hash(const void *buffer, uint16_t length);
+uint8_t ljson_schema_compile(ljson_schema_t *schema, ljson_inst_t *buffer, uint16_t size, const ljson_item_t *top);
+void ljson_schema_want(const ljson_schema_t *schema, uint8_t *want);
+uint16_t ljson_schema_path(const ljson_schema_t *schema, uint16_t item, char *buffer, uint16_t size);
+uint16_t ljson_schema_find(const ljson_schema_t *schema, const char *path);
+uint8_t ljson_schema_select(const ljson_schema_t *schema, uint8_t *mask, const char *fields);
+void ljson_schema_touch(const ljson_schema_t *schema, uint8_t *dirty, uint16_t item);
+
+////////////////////////////////////////
+
+void ljson_contex_init(ljson_contex_t *contex, const ljson_schema_t *schema, void *base);
+void ljson_contex_track(ljson_contex_t *contex, uint8_t *mask, const uint8_t *want);
+void ljson_contex_fingerprint(ljson_contex_t *contex, uint32_t *print, uint8_t *change);
+void ljson_contex_project(ljson_contex_t *contex, const uint8_t *project);
 uint8_t ljson_contex_push(ljson_contex_t *contex, uint8_t type);
 uint8_t ljson_contex_pop(ljson_contex_t *contex, uint8_t type);
+uint8_t ljson_contex_next(ljson_contex_t *contex, uint8_t *type);
+uint8_t *ljson_contex_buffer(ljson_contex_t *contex);
+uint32_t ljson_contex_count(ljson_contex_t *contex);
+uint8_t ljson_contex_seek(ljson_contex_t *contex, uint32_t index);
+uint8_t ljson_contex_compare(ljson_contex_t *contex, uint8_t *dirty, const void *snapshot);
+uint8_t ljson_contex_write(ljson_contex_t *contex, ljson_writer_t *writer, uint8_t fmt);
+uint8_t ljson_contex_write_part(ljson_contex_t *contex, ljson_writer_t *writer, uint16_t item, uint32_t count);
 uint16_t ljson_contex_snprintf(ljson_contex_t *contex, void *buffer, uint16_t size, uint8_t fmt);
+uint8_t ljson_diff(const ljson_schema_t *schema, const void *old_base, void *new_base, uint8_t *dirty, ljson_writer_t *writer);
+
+////////////////////////////////////////
+
+uint8_t ljson_serializer_compile(ljson_serializer_t *serializer, const ljson_schema_t *schema, uint16_t *offset, char *buffer, uint16_t size);
+uint8_t ljson_serializer_write(const ljson_serializer_t *serializer, ljson_contex_t *contex, ljson_writer_t *writer);
+
+////////////////////////////////////////
+
+uint8_t ljson_dict_init(ljson_dict_t *dict, const char *const *name, uint16_t count, uint16_t *slot, uint16_t size);
+uint16_t ljson_dict_find(const ljson_dict_t *dict, uint32_t hash, const void *key, uint16_t length);
 
 ////////////////////////////////////////
 
 void ljson_parser_init(ljson_parser_t *parser, ljson_callback_t callback, void *user);
 uint8_t ljson_parser_feed(ljson_parser_t *parser, const void *buffer, uint16_t length);
+uint8_t ljson_parser_flush(const void *buffer, uint16_t length, void *user);
 uint8_t ljson_callback_default(uint8_t type, uint8_t *buffer, uint16_t length, void *user);
 
 ////////////////////////////////////////
@@ -0,0 +1,691 @@
+#include "ljson_cbor.h"
+#include <string.h> /* memset, memcpy, strlen */
+#include <math.h> /* ldexp */
+
+#define LJSON_CBOR_HEAD         0x00    /* initial byte */
+#define LJSON_CBOR_ARG          0x01    /* bytes of the argument */
+#define LJSON_CBOR_STRING       0x02    /* bytes of a string value */
+#define LJSON_CBOR_KEY          0x03    /* bytes of a key */
+
+#define LJSON_CBOR_OBJECT       0x01    /* ljson_cbor_t.kind, a map */
+#define LJSON_CBOR_VALUE        0x02    /* key read, the value next */
+#define LJSON_CBOR_RAW          0x04    /* an array of items as text */
+
+#define LJSON_CBOR_MORE         0xFFFFFFFF  /* ljson_cbor_t.left, indefinite length */
+#define LJSON_CBOR_BREAK        0xFF
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* initial byte, then size bytes of value big-endian */
+static uint8_t _ljson_cbor_put(ljson_writer_t *writer, uint8_t initial, uint64_t value, uint8_t size)
+{
+    uint8_t buffer[9];
+    uint8_t i;
+
+    buffer[0] = initial;
+    for (i = size; i > 0; i--)
+    {
+        buffer[i] = (uint8_t)value;
+        value >>= 8;
+    }
+
+    return ljson_writer_write(writer, buffer, size + 1);
+}
+
+/* major type with its argument in the fewest bytes */
+uint8_t ljson_cbor_head(ljson_writer_t *writer, uint8_t major, uint64_t value)
+{
+    major <<= 5;
+    if (value < 24)
+    {
+        return _ljson_cbor_put(writer, major | (uint8_t)value, 0, 0);
+    }
+    if (value <= 0xFF)
+    {
+        return _ljson_cbor_put(writer, major | 24, value, 1);
+    }
+    if (value <= 0xFFFF)
+    {
+        return _ljson_cbor_put(writer, major | 25, value, 2);
+    }
+    if (value <= 0xFFFFFFFF)
+    {
+        return _ljson_cbor_put(writer, major | 26, value, 4);
+    }
+
+    return _ljson_cbor_put(writer, major | 27, value, 8);
+}
+
+uint8_t ljson_cbor_integer(ljson_writer_t *writer, int64_t value)
+{
+    if (value < 0)
+    {
+        /* -1 - n */
+        return ljson_cbor_head(writer, LJSON_CBOR_NEGATIVE, ~(uint64_t)value);
+    }
+
+    return ljson_cbor_head(writer, LJSON_CBOR_UNSIGNED, (uint64_t)value);
+}
+
+uint8_t ljson_cbor_real(ljson_writer_t *writer, double value)
+{
+    uint64_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    return _ljson_cbor_put(writer, (LJSON_CBOR_SIMPLE << 5) | 27, bits, 8);
+}
+
+static uint8_t _ljson_cbor_float(ljson_writer_t *writer, float value)
+{
+    uint32_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    return _ljson_cbor_put(writer, (LJSON_CBOR_SIMPLE << 5) | 26, bits, 4);
+}
+
+/* text string, src kept in place as ljson_writer_reference */
+uint8_t ljson_cbor_string(ljson_writer_t *writer, const void *src, uint32_t length)
+{
+    ljson_cbor_head(writer, LJSON_CBOR_TEXT, length);
+
+    return ljson_writer_reference(writer, src, length);
+}
+
+static int64_t _ljson_cbor_signed(const void *src, uint16_t length)
+{
+    switch (length)
+    {
+    case sizeof(int8_t) :
+        return *(const int8_t *)src;
+    case sizeof(int16_t) :
+        return *(const int16_t *)src;
+    case sizeof(int32_t) :
+        return *(const int32_t *)src;
+    case sizeof(int64_t) :
+        return *(const int64_t *)src;
+    default:
+        return 0;
+    }
+}
+
+static uint64_t _ljson_cbor_unsigned(const void *src, uint16_t length)
+{
+    switch (length)
+    {
+    case sizeof(uint8_t) :
+        return *(const uint8_t *)src;
+    case sizeof(uint16_t) :
+        return *(const uint16_t *)src;
+    case sizeof(uint32_t) :
+        return *(const uint32_t *)src;
+    case sizeof(uint64_t) :
+        return *(const uint64_t *)src;
+    default:
+        return 0;
+    }
+}
+
+/* number at src, as wide as the field */
+static void _ljson_cbor_number(ljson_writer_t *writer, const ljson_inst_t *inst, const uint8_t *src)
+{
+    switch (inst->type)
+    {
+    case LJSON_ITEM_INTEGER:
+        ljson_cbor_integer(writer, _ljson_cbor_signed(src, inst->length));
+        break;
+    case LJSON_ITEM_UNSIGNED:
+        ljson_cbor_head(writer, LJSON_CBOR_UNSIGNED, _ljson_cbor_unsigned(src, inst->length));
+        break;
+    default:
+        if (inst->length == sizeof(float))
+        {
+            _ljson_cbor_float(writer, *(const float *)src);
+        }
+        else
+        {
+            ljson_cbor_real(writer, *(const double *)src);
+        }
+        break;
+    }
+}
+
+/* members of the object on the top the walk goes through */
+static uint32_t _ljson_cbor_members(ljson_contex_t *contex)
+{
+    const ljson_inst_t *inst_top = ljson_contex_top(contex);
+    uint32_t count = 0;
+    uint16_t i;
+
+    if (contex->project == 0)
+    {
+        return inst_top->length;
+    }
+    for (i = 0; i < inst_top->length; i++)
+    {
+        if (ljson_mask_get(contex->project, inst_top->child + i))
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/* items of the array on the top if numbers in its own storage, one after another */
+static void _ljson_cbor_numbers(ljson_contex_t *contex, ljson_writer_t *writer)
+{
+    const ljson_inst_t *inst_top = ljson_contex_top(contex);
+    const ljson_inst_t *inst = &contex->schema->inst[inst_top->child];
+    const uint8_t *item_buffer;
+    uint32_t count = ljson_contex_count(contex);
+    uint32_t i;
+    uint8_t type;
+
+    if (((inst_top->type != LJSON_ITEM_ARRAY) && (inst_top->type != LJSON_ITEM_VECTOR))
+        || ((inst->type != LJSON_ITEM_INTEGER) && (inst->type != LJSON_ITEM_UNSIGNED) && (inst->type != LJSON_ITEM_REAL))
+        || (count == 0))
+    {
+        return;
+    }
+
+    /* the first item gives the address of the rest */
+    ljson_contex_next(contex, &type);
+    item_buffer = ljson_contex_buffer(contex);
+    for (i = 0; (i < count) && (writer->error == LJSON_ERROR_NONE); i++)
+    {
+        _ljson_cbor_number(writer, inst, item_buffer);
+        item_buffer += inst_top->offset;
+    }
+    /* LJSON_TYPE_ARRAY_R next */
+    ljson_contex_seek(contex, count);
+}
+
+/* value of the current leaf */
+static uint8_t _ljson_cbor_leaf(ljson_contex_t *contex, ljson_writer_t *writer, const ljson_inst_t *inst)
+{
+    const uint8_t *item_buffer = ljson_contex_buffer(contex);
+    ljson_raw_t raw;
+    uint32_t length;
+    uint32_t call;
+    uint8_t res;
+
+    switch (inst->type)
+    {
+    case LJSON_ITEM_STRING: /* text string, up to the '\0' */
+        length = 0;
+        while ((length < inst->length) && (item_buffer[length] != '\0'))
+        {
+            length++;
+        }
+        ljson_cbor_string(writer, item_buffer, length);
+        break;
+    case LJSON_ITEM_INTEGER:
+    case LJSON_ITEM_UNSIGNED:
+    case LJSON_ITEM_REAL:
+        _ljson_cbor_number(writer, inst, item_buffer);
+        break;
+    case LJSON_ITEM_BOOLEAN: /* simple 20 21 */
+        _ljson_cbor_put(writer, (LJSON_CBOR_SIMPLE << 5) | ((*item_buffer) ? 21 : 20), 0, 0);
+        break;
+    case LJSON_ITEM_CALLBACK: /* produced by the callback, null if nothing */
+        length = writer->length;
+        call = 0;
+        do
+        {
+            /* set each time, a nested write may have used it */
+            writer->call = call;
+            res = ((ljson_callback_t)item_buffer)(LJSON_TYPE_WRITE_CBOR, (uint8_t *)writer, (uint16_t)((call < 0xFFFF) ? call : 0xFFFF), contex);
+            call++;
+        } while ((res == LJSON_ERROR_MORE) && (writer->error == LJSON_ERROR_NONE));
+        if (res != LJSON_ERROR_NONE)
+        {
+            return res;
+        }
+        if (writer->length == length)
+        {
+            _ljson_cbor_put(writer, (LJSON_CBOR_SIMPLE << 5) | 22, 0, 0);
+        }
+        break;
+    case LJSON_ITEM_RAW: /* the JSON text as a text string, null if never bound */
+        if (inst->length == 0)
+        {
+            raw = *(const ljson_raw_t *)item_buffer;
+        }
+        else
+        {
+            raw.buffer = (const char *)item_buffer;
+            raw.length = (uint32_t)strlen(raw.buffer);
+        }
+        if (raw.length > 0)
+        {
+            ljson_cbor_string(writer, raw.buffer, raw.length);
+        }
+        else
+        {
+            _ljson_cbor_put(writer, (LJSON_CBOR_SIMPLE << 5) | 22, 0, 0);
+        }
+        break;
+    default: /* LJSON_ITEM_UNION with no case for the tag */
+        _ljson_cbor_put(writer, (LJSON_CBOR_SIMPLE << 5) | 22, 0, 0);
+        break;
+    }
+
+    return LJSON_ERROR_NONE;
+}
+
+/* the document as CBOR, arrays and maps of definite length, the sink flushed at the end */
+uint8_t ljson_cbor_write(ljson_contex_t *contex, ljson_writer_t *writer)
+{
+    const ljson_inst_t *inst;
+    const char *name;
+    uint8_t type;
+    uint8_t res;
+
+    while (writer->error == LJSON_ERROR_NONE)
+    {
+        res = ljson_contex_next(contex, &type);
+        if (res != LJSON_ERROR_NONE)
+        {
+            return res;
+        }
+        if (type == LJSON_TYPE_NONE)
+        {
+            break;
+        }
+        if ((type == LJSON_TYPE_OBJECT_R) || (type == LJSON_TYPE_ARRAY_R))
+        {
+            continue;
+        }
+        inst = ljson_contex_inst(contex);
+
+        if (inst->flag & LJSON_INST_KEY)
+        {
+            if (inst->name == 0)
+            {
+                /* error */
+                return LJSON_ERROR_ITEM_NAME;
+            }
+
+            /* a case is written under the name of its union */
+            name = (inst->flag & LJSON_INST_CASE) ? contex->schema->inst[inst->parent].name : inst->name;
+            ljson_cbor_string(writer, name, (uint32_t)strlen(name));
+        }
+
+        switch (type)
+        {
+        case LJSON_TYPE_OBJECT_L:
+            ljson_cbor_head(writer, LJSON_CBOR_MAP, _ljson_cbor_members(contex));
+            break;
+        case LJSON_TYPE_ARRAY_L:
+            ljson_cbor_head(writer, LJSON_CBOR_ARRAY, ljson_contex_count(contex));
+            _ljson_cbor_numbers(contex, writer);
+            break;
+        default:
+            res = _ljson_cbor_leaf(contex, writer, inst);
+            if (res != LJSON_ERROR_NONE)
+            {
+                return res;
+            }
+            break;
+        }
+    }
+    if (writer->error != LJSON_ERROR_NONE)
+    {
+        return writer->error;
+    }
+
+    return ljson_writer_flush(writer);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ljson_cbor_init(ljson_cbor_t *cbor, ljson_callback_t callback, void *user)
+{
+    memset(cbor, 0, sizeof(ljson_cbor_t));
+
+    cbor->state = LJSON_CBOR_HEAD;
+    cbor->user = user;
+    cbor->callback = callback;
+}
+
+/* a callback stopped the feed, bytes before end consumed */
+static uint8_t _ljson_cbor_stop(ljson_cbor_t *cbor, const void *buffer, const uint8_t *end, uint8_t res)
+{
+    cbor->used = (uint16_t)(end - (const uint8_t *)buffer);
+
+    return res;
+}
+
+static double _ljson_cbor_single(uint32_t bits)
+{
+    float value;
+
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+
+static double _ljson_cbor_half(uint16_t half)
+{
+    uint16_t exponent = (half >> 10) & 0x1F;
+    uint16_t mantissa = half & 0x3FF;
+    double value;
+
+    if (exponent == 0)
+    {
+        value = ldexp(mantissa, -24);
+    }
+    else if (exponent < 31)
+    {
+        value = ldexp(mantissa + 1024, exponent - 25);
+    }
+    else
+    {
+        value = (mantissa == 0) ? HUGE_VAL : (HUGE_VAL - HUGE_VAL);
+    }
+
+    return (half & 0x8000) ? -value : value;
+}
+
+/* a value done in the container on the top, then the containers with nothing left closed */
+static uint8_t _ljson_cbor_done(ljson_cbor_t *cbor)
+{
+    uint8_t *kind;
+    uint32_t *left;
+    uint8_t res;
+
+    cbor->state = LJSON_CBOR_HEAD;
+    while (cbor->level > 0)
+    {
+        kind = &cbor->kind[cbor->level - 1];
+        left = &cbor->left[cbor->level - 1];
+        if (*kind & LJSON_CBOR_VALUE)
+        {
+            *kind &= ~LJSON_CBOR_VALUE;
+            if (*left != LJSON_CBOR_MORE)
+            {
+                (*left)--;
+            }
+        }
+        if (*left != 0)
+        {
+            break;
+        }
+        res = cbor->callback((*kind & LJSON_CBOR_OBJECT) ? LJSON_TYPE_OBJECT_R : LJSON_TYPE_ARRAY_R, 0, 0, cbor->user);
+        if (res != LJSON_ERROR_NONE)
+        {
+            return res;
+        }
+        cbor->level--;
+    }
+
+    return LJSON_ERROR_NONE;
+}
+
+/* string in buffer, a key or a value */
+static uint8_t _ljson_cbor_string(ljson_cbor_t *cbor)
+{
+    uint8_t res;
+
+    cbor->buffer[cbor->size] = '\0';
+    if (cbor->state == LJSON_CBOR_KEY)
+    {
+        cbor->state = LJSON_CBOR_HEAD;
+        cbor->kind[cbor->level - 1] |= LJSON_CBOR_VALUE;
+        res = cbor->callback(LJSON_TYPE_KEY, cbor->buffer, cbor->size, cbor->user);
+        if (res == LJSON_ERROR_RAW)
+        {
+            /* the value as text */
+            cbor->raw = 1;
+            res = LJSON_ERROR_NONE;
+        }
+        return res;
+    }
+    res = cbor->callback(LJSON_TYPE_STRING, cbor->buffer, cbor->size, cbor->user);
+    if (res != LJSON_ERROR_NONE)
+    {
+        return res;
+    }
+
+    return _ljson_cbor_done(cbor);
+}
+
+/* value of one of the LJSON_TYPE_XXX, then done */
+static uint8_t _ljson_cbor_value(ljson_cbor_t *cbor, uint8_t type, const void *buffer, uint16_t length)
+{
+    uint8_t res;
+
+    if (type == LJSON_TYPE_TOKEN)
+    {
+        /* writable, with its '\0' */
+        memcpy(cbor->buffer, buffer, length + 1);
+    }
+    res = cbor->callback(type, (type == LJSON_TYPE_TOKEN) ? cbor->buffer : (uint8_t *)buffer, length, cbor->user);
+    if (res != LJSON_ERROR_NONE)
+    {
+        return res;
+    }
+
+    return _ljson_cbor_done(cbor);
+}
+
+/* text of the value in pieces as LJSON_TYPE_RAW, the last as LJSON_TYPE_RAW_END */
+static uint8_t _ljson_cbor_raw(ljson_cbor_t *cbor, const uint8_t *buffer, uint16_t length)
+{
+    uint8_t res;
+
+    cbor->length -= length;
+    if (cbor->length > 0)
+    {
+        return cbor->callback(LJSON_TYPE_RAW, (uint8_t *)buffer, length, cbor->user);
+    }
+    cbor->raw = 0;
+    res = cbor->callback(LJSON_TYPE_RAW_END, (uint8_t *)buffer, length, cbor->user);
+    if (res != LJSON_ERROR_NONE)
+    {
+        return res;
+    }
+
+    return _ljson_cbor_done(cbor);
+}
+
+/* the head of an item read */
+static uint8_t _ljson_cbor_item(ljson_cbor_t *cbor)
+{
+    uint8_t major = cbor->head >> 5;
+    uint8_t more = ((cbor->head & 0x1F) == 31);
+    uint8_t *kind = (cbor->level > 0) ? &cbor->kind[cbor->level - 1] : 0;
+    uint8_t res;
+
+    cbor->state = LJSON_CBOR_HEAD;
+    if (major == LJSON_CBOR_TAG)
+    {
+        /* the item it wraps stands for it */
+        return LJSON_ERROR_NONE;
+    }
+    if (cbor->head == LJSON_CBOR_BREAK)
+    {
+        if ((kind == 0) || (cbor->left[cbor->level - 1] != LJSON_CBOR_MORE) || (*kind & LJSON_CBOR_VALUE))
+        {
+            return LJSON_ERROR_CBOR;
+        }
+        cbor->left[cbor->level - 1] = 0;
+        return _ljson_cbor_done(cbor);
+    }
+    if ((kind != 0) && (*kind == LJSON_CBOR_OBJECT))
+    {
+        /* a key */
+        if ((major != LJSON_CBOR_TEXT) || more)
+        {
+            return LJSON_ERROR_KEY_L;
+        }
+        if (cbor->value >= sizeof(cbor->buffer))
+        {
+            return LJSON_ERROR_BUFFER_OVER;
+        }
+        cbor->state = LJSON_CBOR_KEY;
+        cbor->length = (uint32_t)cbor->value;
+        cbor->size = 0;
+        return (cbor->length == 0) ? _ljson_cbor_string(cbor) : LJSON_ERROR_NONE;
+    }
+    if ((kind != 0) && (*kind & LJSON_CBOR_RAW))
+    {
+        cbor->raw = 1;
+    }
+    if (cbor->raw && (major != LJSON_CBOR_TEXT))
+    {
+        /* only text stands for text */
+        return LJSON_ERROR_ITEM_TYPE;
+    }
+    if (kind != 0)
+    {
+        *kind |= LJSON_CBOR_VALUE;
+    }
+
+    switch (major)
+    {
+    case LJSON_CBOR_UNSIGNED:
+        return _ljson_cbor_value(cbor, LJSON_TYPE_UNSIGNED, &cbor->value, sizeof(cbor->value));
+    case LJSON_CBOR_NEGATIVE:
+        /* -1 - n */
+        cbor->value = ~cbor->value;
+        return _ljson_cbor_value(cbor, LJSON_TYPE_INTEGER, &cbor->value, sizeof(cbor->value));
+    case LJSON_CBOR_BYTES:
+    case LJSON_CBOR_TEXT:
+        if (more || (cbor->value > 0xFFFFFFFF))
+        {
+            /* no strings in chunks */
+            return LJSON_ERROR_CBOR;
+        }
+        if (!cbor->raw && (cbor->value >= sizeof(cbor->buffer)))
+        {
+            return LJSON_ERROR_BUFFER_OVER;
+        }
+        cbor->state = LJSON_CBOR_STRING;
+        cbor->length = (uint32_t)cbor->value;
+        cbor->size = 0;
+        if (cbor->length > 0)
+        {
+            return LJSON_ERROR_NONE;
+        }
+        return cbor->raw ? _ljson_cbor_raw(cbor, cbor->buffer, 0) : _ljson_cbor_string(cbor);
+    case LJSON_CBOR_ARRAY:
+    case LJSON_CBOR_MAP:
+        if (cbor->level >= LJSON_CBOR_STACK_SIZE)
+        {
+            return LJSON_ERROR_STACK_OVER;
+        }
+        if (!more && (cbor->value >= LJSON_CBOR_MORE))
+        {
+            return LJSON_ERROR_CBOR;
+        }
+        res = cbor->callback((major == LJSON_CBOR_MAP) ? LJSON_TYPE_OBJECT_L : LJSON_TYPE_ARRAY_L, 0, 0, cbor->user);
+        if ((res != LJSON_ERROR_NONE) && (res != LJSON_ERROR_RAW))
+        {
+            return res;
+        }
+        cbor->kind[cbor->level] = (major == LJSON_CBOR_MAP) ? LJSON_CBOR_OBJECT : ((res == LJSON_ERROR_RAW) ? LJSON_CBOR_RAW : 0);
+        cbor->left[cbor->level] = more ? LJSON_CBOR_MORE : (uint32_t)cbor->value;
+        cbor->level++;
+        return _ljson_cbor_done(cbor);
+    default:
+        break;
+    }
+
+    switch (cbor->head & 0x1F)
+    {
+    case 20:
+        return _ljson_cbor_value(cbor, LJSON_TYPE_TOKEN, "false", 5);
+    case 21:
+        return _ljson_cbor_value(cbor, LJSON_TYPE_TOKEN, "true", 4);
+    case 22: /* null */
+    case 23: /* undefined */
+        return _ljson_cbor_value(cbor, LJSON_TYPE_TOKEN, "null", 4);
+    case 25:
+        cbor->real = _ljson_cbor_half((uint16_t)cbor->value);
+        break;
+    case 26:
+        cbor->real = _ljson_cbor_single((uint32_t)cbor->value);
+        break;
+    case 27:
+        memcpy(&cbor->real, &cbor->value, sizeof(cbor->real));
+        break;
+    default:
+        return LJSON_ERROR_CBOR;
+    }
+
+    return _ljson_cbor_value(cbor, LJSON_TYPE_REAL, &cbor->real, sizeof(cbor->real));
+}
+
+uint8_t ljson_cbor_feed(ljson_cbor_t *cbor, const void *buffer, uint16_t length)
+{
+    const uint8_t *cp = (const uint8_t *)buffer;
+    const uint8_t *eob = cp + length;
+    uint16_t size;
+    uint8_t res = LJSON_ERROR_NONE;
+
+    cbor->used = length;
+    while (cp < eob)
+    {
+        switch (cbor->state)
+        {
+        case LJSON_CBOR_HEAD:
+            cbor->head = *cp++;
+            cbor->value = cbor->head & 0x1F;
+            cbor->need = 0;
+            if ((cbor->value >= 24) && (cbor->value <= 27))
+            {
+                cbor->need = (uint8_t)(1 << (cbor->value - 24));
+                cbor->value = 0;
+            }
+            else if (((cbor->value >= 28) && (cbor->value <= 30))
+                || ((cbor->value == 31) && (((cbor->head >> 5) <= LJSON_CBOR_NEGATIVE) || ((cbor->head >> 5) == LJSON_CBOR_TAG))))
+            {
+                /* reserved, or no indefinite length for integers and tags; 0xFF is the only other major 7 with 31 */
+                return _ljson_cbor_stop(cbor, buffer, cp, LJSON_ERROR_CBOR);
+            }
+            cbor->state = LJSON_CBOR_ARG;
+            /* no break */
+        case LJSON_CBOR_ARG:
+            while ((cbor->need > 0) && (cp < eob))
+            {
+                cbor->value = (cbor->value << 8) | *cp++;
+                cbor->need--;
+            }
+            if (cbor->need == 0)
+            {
+                res = _ljson_cbor_item(cbor);
+            }
+            break;
+        case LJSON_CBOR_STRING:
+        case LJSON_CBOR_KEY:
+            size = (cbor->length < (uint32_t)(eob - cp)) ? (uint16_t)cbor->length : (uint16_t)(eob - cp);
+            if (cbor->raw && (cbor->state == LJSON_CBOR_STRING))
+            {
+                /* in place, gone with the feed */
+                res = _ljson_cbor_raw(cbor, cp, size);
+                cp += size;
+                break;
+            }
+            memcpy(cbor->buffer + cbor->size, cp, size);
+            cbor->size += size;
+            cbor->length -= size;
+            cp += size;
+            if (cbor->length == 0)
+            {
+                res = _ljson_cbor_string(cbor);
+            }
+            break;
+        default:
+            return LJSON_ERROR_CBOR;
+        }
+        if (res != LJSON_ERROR_NONE)
+        {
+            return _ljson_cbor_stop(cbor, buffer, cp, res);
+        }
+    }
+
+    return LJSON_ERROR_NONE;
+}
@@ -0,0 +1,63 @@
+#ifndef _LJSON_CBOR_H_
+#define _LJSON_CBOR_H_
+
+#include "ljson.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LJSON_CBOR_STACK_SIZE   LJSON_CONTEX_STACK_SIZE    /* nested arrays and maps of ljson_cbor_t */
+
+#define LJSON_CBOR_UNSIGNED     0x00    /* major types, RFC 8949 */
+#define LJSON_CBOR_NEGATIVE     0x01
+#define LJSON_CBOR_BYTES        0x02
+#define LJSON_CBOR_TEXT         0x03
+#define LJSON_CBOR_ARRAY        0x04
+#define LJSON_CBOR_MAP          0x05
+#define LJSON_CBOR_TAG          0x06
+#define LJSON_CBOR_SIMPLE       0x07
+
+////////////////////////////////////////
+
+/* CBOR in, the same callback events as ljson_parser_t, numbers as LJSON_TYPE_INTEGER LJSON_TYPE_UNSIGNED LJSON_TYPE_REAL */
+typedef struct _ljson_cbor
+{
+    uint8_t state;
+    uint8_t head;       /* initial byte of the item being read */
+    uint8_t need;       /* bytes of its argument still to come */
+    uint64_t value;     /* argument, the LJSON_TYPE_INTEGER LJSON_TYPE_UNSIGNED value */
+    double real;        /* LJSON_TYPE_REAL value */
+    uint32_t length;    /* bytes of the string still to come */
+    uint16_t size;      /* bytes of the string in buffer */
+    uint8_t raw;        /* the value comes as LJSON_TYPE_RAW, it must be a text string */
+    uint8_t level;
+    uint32_t left[LJSON_CBOR_STACK_SIZE];   /* items or pairs left, 0xFFFFFFFF until a break */
+    uint8_t kind[LJSON_CBOR_STACK_SIZE];
+    uint8_t buffer[LJSON_BUFFER_SIZE];
+    uint16_t used;      /* bytes of the last ljson_cbor_feed consumed, less if a callback stopped it */
+
+    void *user;
+    ljson_callback_t callback;
+} ljson_cbor_t;
+
+////////////////////////////////////////
+
+uint8_t ljson_cbor_head(ljson_writer_t *writer, uint8_t major, uint64_t value);
+uint8_t ljson_cbor_integer(ljson_writer_t *writer, int64_t value);
+uint8_t ljson_cbor_real(ljson_writer_t *writer, double value);
+uint8_t ljson_cbor_string(ljson_writer_t *writer, const void *src, uint32_t length);
+uint8_t ljson_cbor_write(ljson_contex_t *contex, ljson_writer_t *writer);
+
+////////////////////////////////////////
+
+void ljson_cbor_init(ljson_cbor_t *cbor, ljson_callback_t callback, void *user);
+uint8_t ljson_cbor_feed(ljson_cbor_t *cbor, const void *buffer, uint16_t length);
+
+////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !_LJSON_CBOR_H_
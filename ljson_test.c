@@ -1,5 +1,16 @@
 #include <stdio.h>
+#include <string.h>
+#include <locale.h>
 #include "ljson.h"
+#include "ljson_thread.h"
+#include "ljson_cbor.h"
+#include "ljson_zlib.h"
+
+/* cc ljson.c ljson_cbor.c ljson_zlib.c ljson_thread.c ljson_test.c -lm -lpthread */
+
+/* checks of behaviour after the demo, failures counted in test_fail */
+static int test_fail;
+#define TEST_CHECK(cond)    do { if (!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); test_fail++; } } while (0)
 
 ////////////////////////////////////////
 
@@ -18,6 +29,7 @@ typedef struct _school
     uint16_t number;
     student_t teacher;
     student_t student[30];
+    uint32_t student_count;
     uint16_t height[20];
     double width[10][10];
 } school_t;
@@ -26,6 +38,9 @@ typedef struct _school
 
 school_t school;
 
+ljson_inst_t schema_buffer[32];
+ljson_schema_t schema;
+
 ////////////////////////////////////////
 
 uint8_t ljson_item_callback(uint8_t type, uint8_t *buffer, uint16_t length, void *user)
@@ -37,36 +52,25 @@ uint8_t ljson_item_callback(uint8_t type, uint8_t *buffer, uint16_t length, void
 
 ////////////////////////////////////////
 
-static const ljson_item_t ljson_teacher[] =
-{
-    { "name", LJSON_ITEM_STRING, sizeof(school.student[0].name), school.student[0].name },
-    { "old", LJSON_ITEM_INTEGER, sizeof(school.student[0].old), &school.student[0].old },
-    { "height", LJSON_ITEM_REAL, sizeof(school.student[0].height), &school.student[0].height },
-    { "width", LJSON_ITEM_REAL, sizeof(school.student[0].width), &school.student[0].width },
-    { "boy", LJSON_ITEM_BOOLEAN, sizeof(school.student[0].boy), &school.student[0].boy },
-};
-
-////////////////////////////////////////
-
 static const ljson_item_t ljson_student[] =
 {
-    { "name", LJSON_ITEM_STRING, sizeof(school.student[0].name), school.student[0].name },
-    { "old", LJSON_ITEM_INTEGER, sizeof(school.student[0].old), &school.student[0].old },
-    { "height", LJSON_ITEM_REAL, sizeof(school.student[0].height), &school.student[0].height },
-    { "width", LJSON_ITEM_REAL, sizeof(school.student[0].width), &school.student[0].width },
-    { "boy", LJSON_ITEM_BOOLEAN, sizeof(school.student[0].boy), &school.student[0].boy },
+    { "name", LJSON_ITEM_STRING, sizeof(school.student[0].name), LJSON_OFFSET(student_t, name) },
+    { "old", LJSON_ITEM_INTEGER, sizeof(school.student[0].old), LJSON_OFFSET(student_t, old) },
+    { "height", LJSON_ITEM_REAL, sizeof(school.student[0].height), LJSON_OFFSET(student_t, height) },
+    { "width", LJSON_ITEM_REAL, sizeof(school.student[0].width), LJSON_OFFSET(student_t, width) },
+    { "boy", LJSON_ITEM_BOOLEAN, sizeof(school.student[0].boy), LJSON_OFFSET(student_t, boy) },
 };
 
 static const ljson_item_t ljson_array_student[] =
 {
-    { 0, LJSON_ITEM_OBJECT, countof(ljson_student), (void *)ljson_student },
+    { 0, LJSON_ITEM_OBJECT, countof(ljson_student), (void *)ljson_student, offsetof(school_t, student) },
 };
 
 ////////////////////////////////////////
 
 static const ljson_item_t ljson_array_height[] =
 {
-    //{ 0, LJSON_ITEM_INTEGER, sizeof(school.height[0]), school.height },
+    //{ 0, LJSON_ITEM_INTEGER, sizeof(school.height[0]), LJSON_OFFSET(school_t, height) },
     { 0, LJSON_ITEM_CALLBACK, 0, ljson_item_callback },
 };
 
@@ -74,7 +78,7 @@ static const ljson_item_t ljson_array_height[] =
 
 static const ljson_item_t ljson_array_array_width[] =
 {
-    { 0, LJSON_ITEM_REAL, sizeof(school.width[0][0]), school.width },
+    { 0, LJSON_ITEM_REAL, sizeof(school.width[0][0]), LJSON_OFFSET(school_t, width) },
 };
 
 static const ljson_item_t ljson_array_width[] =
@@ -86,10 +90,10 @@ static const ljson_item_t ljson_array_width[] =
 
 static const ljson_item_t ljson_school[] =
 {
-    { "name", LJSON_ITEM_STRING, sizeof(school.name), school.name },
-    { "number", LJSON_ITEM_INTEGER, sizeof(school.number), &school.number },
-    { "teacher", LJSON_ITEM_OBJECT, countof(ljson_teacher), (void *)ljson_teacher },
-    { "student", LJSON_ITEM_ARRAY, countof(school.student), (void *)ljson_array_student, sizeof(school.student[0]) },
+    { "name", LJSON_ITEM_STRING, sizeof(school.name), LJSON_OFFSET(school_t, name) },
+    { "number", LJSON_ITEM_INTEGER, sizeof(school.number), LJSON_OFFSET(school_t, number) },
+    { "teacher", LJSON_ITEM_OBJECT, countof(ljson_student), (void *)ljson_student, offsetof(school_t, teacher) },
+    { "student", LJSON_ITEM_ARRAY, countof(school.student), (void *)ljson_array_student, sizeof(school.student[0]), LJSON_OFFSET(school_t, student_count) },
     { "height", LJSON_ITEM_ARRAY, 0/*countof(school.height)*/, (void *)ljson_array_height, sizeof(school.height[0]) },
     { "width", LJSON_ITEM_ARRAY, countof(school.width), (void *)ljson_array_width, sizeof(school.width[0]) },
 };
@@ -103,6 +107,1856 @@ static const ljson_item_t ljson_top[] =
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/* text through a parser into contex, LJSON_ERROR_MORE and all */
+static uint8_t test_feed(ljson_contex_t *contex, const char *text)
+{
+    ljson_parser_t parser;
+
+    ljson_parser_init(&parser, ljson_callback_default, contex);
+
+    return ljson_parser_feed(&parser, text, (uint16_t)strlen(text));
+}
+
+////////////////////////////////////////
+
+/* member offsets past 64 KiB */
+typedef struct _test_far
+{
+    char pad[70000];
+    student_t student;
+} test_far_t;
+
+static const ljson_item_t test_far_items[] =
+{
+    { "student", LJSON_ITEM_OBJECT, countof(ljson_student), (void *)ljson_student, offsetof(test_far_t, student) },
+};
+
+static const ljson_item_t test_far_top[] =
+{
+    { 0, LJSON_ITEM_OBJECT, countof(test_far_items), (void *)test_far_items },
+};
+
+static void test_offset(void)
+{
+    static test_far_t far;
+    ljson_inst_t inst[16];
+    ljson_schema_t far_schema;
+    ljson_contex_t contex;
+
+    TEST_CHECK(ljson_schema_compile(&far_schema, inst, countof(inst), test_far_top) == LJSON_ERROR_NONE);
+    ljson_contex_init(&contex, &far_schema, &far);
+    TEST_CHECK(test_feed(&contex, "{\"student\":{\"name\":\"far\",\"old\":7}}") == LJSON_ERROR_NONE);
+    TEST_CHECK((far.student.old == 7) && (strcmp(far.student.name, "far") == 0));
+    TEST_CHECK(far.pad[(uint16_t)offsetof(test_far_t, student)] == 0);
+    /* the 32-bit offset packs with hash, no padding in ljson_inst_t */
+    TEST_CHECK(sizeof(ljson_inst_t) == 2 * sizeof(void *) + 16);
+}
+
+////////////////////////////////////////
+
+/* LJSON_ITEM_STREAM through 3 slots */
+typedef struct _test_ring
+{
+    student_t slot[3];
+    uint32_t count;
+} test_ring_t;
+
+static const ljson_item_t test_ring_slot[] =
+{
+    { 0, LJSON_ITEM_OBJECT, countof(ljson_student), (void *)ljson_student, offsetof(test_ring_t, slot) },
+};
+
+static const ljson_item_t test_ring_items[] =
+{
+    { "student", LJSON_ITEM_STREAM, 3, (void *)test_ring_slot, sizeof(student_t), LJSON_OFFSET(test_ring_t, count) },
+};
+
+static const ljson_item_t test_ring_top[] =
+{
+    { 0, LJSON_ITEM_OBJECT, countof(test_ring_items), (void *)test_ring_items },
+};
+
+static const ljson_item_t test_ring_empty[] =
+{
+    { "student", LJSON_ITEM_STREAM, 0, (void *)test_ring_slot, sizeof(student_t), LJSON_OFFSET(test_ring_t, count) },
+};
+
+static const ljson_item_t test_ring_empty_top[] =
+{
+    { 0, LJSON_ITEM_OBJECT, countof(test_ring_empty), (void *)test_ring_empty },
+};
+
+static uint32_t test_ring_seen;
+
+static uint8_t test_ring_hook(ljson_contex_t *contex, uint32_t index, uint16_t slot)
+{
+    test_ring_t *ring = (test_ring_t *)contex->user;
+
+    TEST_CHECK((index == test_ring_seen) && (slot == index % 3));
+    TEST_CHECK(ring->slot[slot].old == index + 10);
+    test_ring_seen++;
+
+    return LJSON_ERROR_NONE;
+}
+
+static void test_stream(void)
+{
+    static test_ring_t ring;
+    ljson_inst_t inst[16];
+    ljson_schema_t ring_schema;
+    ljson_contex_t contex;
+
+    TEST_CHECK(ljson_schema_compile(&ring_schema, inst, countof(inst), test_ring_empty_top) == LJSON_ERROR_ITEM_TYPE);
+    TEST_CHECK(ljson_schema_compile(&ring_schema, inst, countof(inst), test_ring_top) == LJSON_ERROR_NONE);
+    ljson_contex_init(&contex, &ring_schema, &ring);
+    contex.hook = test_ring_hook;
+    contex.user = &ring;
+    TEST_CHECK(test_feed(&contex, "{\"student\":[{\"old\":10},{\"old\":11,\"name\":\"b\"},{\"old\":12},{\"old\":13},"
+        "{\"old\":14},{\"old\":15},{\"old\":16}]}") == LJSON_ERROR_NONE);
+    TEST_CHECK((test_ring_seen == 7) && (ring.count == 7));
+    /* slots are zeroed before reuse */
+    TEST_CHECK((ring.slot[0].old == 16) && (ring.slot[1].old == 14) && (ring.slot[1].name[0] == '\0') && (ring.slot[2].old == 15));
+}
+
+////////////////////////////////////////
+
+/* LJSON_ITEM_UNION "body" selected by "type" */
+typedef struct _test_point
+{
+    int32_t x;
+    int32_t y;
+} test_point_t;
+
+typedef struct _test_shape
+{
+    char type[8];
+    int32_t num;
+    test_point_t point;
+    char text[8];
+} test_shape_t;
+
+static const ljson_item_t test_point_items[] =
+{
+    { "x", LJSON_ITEM_INTEGER, sizeof(int32_t), LJSON_OFFSET(test_point_t, x) },
+    { "y", LJSON_ITEM_INTEGER, sizeof(int32_t), LJSON_OFFSET(test_point_t, y) },
+};
+
+static const ljson_item_t test_shape_case[] =
+{
+    { "num", LJSON_ITEM_INTEGER, sizeof(int32_t), LJSON_OFFSET(test_shape_t, num) },
+    { "point", LJSON_ITEM_OBJECT, countof(test_point_items), (void *)test_point_items, offsetof(test_shape_t, point) },
+    { "text", LJSON_ITEM_STRING, sizeof(((test_shape_t *)0)->text), LJSON_OFFSET(test_shape_t, text) },
+};
+
+static const ljson_item_t test_shape_items[] =
+{
+    { "type", LJSON_ITEM_STRING, sizeof(((test_shape_t *)0)->type), LJSON_OFFSET(test_shape_t, type) },
+    { "body", LJSON_ITEM_UNION, countof(test_shape_case), (void *)test_shape_case, 0 },
+};
+
+static const ljson_item_t test_shape_top[] =
+{
+    { 0, LJSON_ITEM_OBJECT, countof(test_shape_items), (void *)test_shape_items },
+};
+
+static ljson_inst_t test_shape_inst[16];
+static ljson_schema_t test_shape_schema;
+
+/* one shape from text, with an arena for a body before its tag */
+static uint8_t test_shape(test_shape_t *shape, const char *text)
+{
+    static uint8_t buffer[256];
+    ljson_arena_t arena;
+    ljson_contex_t contex;
+
+    memset(shape, 0, sizeof(test_shape_t));
+    ljson_arena_init(&arena, buffer, sizeof(buffer));
+    ljson_contex_init(&contex, &test_shape_schema, shape);
+    contex.arena = &arena;
+
+    return test_feed(&contex, text);
+}
+
+static void test_union(void)
+{
+    test_shape_t shape;
+
+    TEST_CHECK(ljson_schema_compile(&test_shape_schema, test_shape_inst, countof(test_shape_inst), test_shape_top) == LJSON_ERROR_NONE);
+    /* tag first */
+    TEST_CHECK(test_shape(&shape, "{\"type\":\"num\",\"body\":42}") == LJSON_ERROR_NONE);
+    TEST_CHECK(shape.num == 42);
+    TEST_CHECK(test_shape(&shape, "{\"type\":\"point\",\"body\":{\"x\":1,\"y\":2}}") == LJSON_ERROR_NONE);
+    TEST_CHECK((shape.point.x == 1) && (shape.point.y == 2));
+    /* body first */
+    TEST_CHECK(test_shape(&shape, "{\"body\":42,\"type\":\"num\"}") == LJSON_ERROR_NONE);
+    TEST_CHECK(shape.num == 42);
+    TEST_CHECK(test_shape(&shape, "{\"body\" : -7 ,\"type\":\"num\"}") == LJSON_ERROR_NONE);
+    TEST_CHECK(shape.num == -7);
+    TEST_CHECK(test_shape(&shape, "{\"body\":{\"x\":3,\"y\":4},\"type\":\"point\"}") == LJSON_ERROR_NONE);
+    TEST_CHECK((shape.point.x == 3) && (shape.point.y == 4));
+    TEST_CHECK(test_shape(&shape, "{\"body\":\"abc\",\"type\":\"text\"}") == LJSON_ERROR_NONE);
+    TEST_CHECK(strcmp(shape.text, "abc") == 0);
+}
+
+////////////////////////////////////////
+
+/* LJSON_ITEM_VECTOR growing from an arena, without a bound and with one */
+typedef struct _test_bag
+{
+    ljson_vector_t all;
+    ljson_vector_t few;
+} test_bag_t;
+
+static const ljson_item_t test_bag_element[] =
+{
+    { 0, LJSON_ITEM_INTEGER, sizeof(int32_t), 0 },
+};
+
+static const ljson_item_t test_bag_items[] =
+{
+    { "all", LJSON_ITEM_VECTOR, 0, (void *)test_bag_element, sizeof(int32_t), LJSON_OFFSET(test_bag_t, all) },
+    { "few", LJSON_ITEM_VECTOR, 6, (void *)test_bag_element, sizeof(int32_t), LJSON_OFFSET(test_bag_t, few) },
+};
+
+static const ljson_item_t test_bag_top[] =
+{
+    { 0, LJSON_ITEM_OBJECT, countof(test_bag_items), (void *)test_bag_items },
+};
+
+static ljson_inst_t test_bag_inst[8];
+static ljson_schema_t test_bag_schema;
+
+static uint8_t test_bag(test_bag_t *bag, uint32_t size, const char *text)
+{
+    static uint8_t buffer[256];
+    ljson_arena_t arena;
+    ljson_contex_t contex;
+
+    memset(bag, 0, sizeof(test_bag_t));
+    ljson_arena_init(&arena, buffer, size);
+    ljson_contex_init(&contex, &test_bag_schema, bag);
+    contex.arena = (size > 0) ? &arena : 0;
+
+    return test_feed(&contex, text);
+}
+
+static void test_vector(void)
+{
+    test_bag_t bag;
+    int32_t *element;
+    uint32_t i;
+
+    TEST_CHECK(ljson_schema_compile(&test_bag_schema, test_bag_inst, countof(test_bag_inst), test_bag_top) == LJSON_ERROR_NONE);
+    /* past LJSON_VECTOR_SIZE, the capacity doubles */
+    TEST_CHECK(test_bag(&bag, 256, "{\"all\":[1,2,3,4,5,6,7,8,9,10]}") == LJSON_ERROR_NONE);
+    TEST_CHECK((bag.all.count == 10) && (bag.all.size == LJSON_VECTOR_SIZE * 4));
+    element = (int32_t *)bag.all.buffer;
+    for (i = 0; i < bag.all.count; i++)
+    {
+        TEST_CHECK(element[i] == (int32_t)(i + 1));
+    }
+    TEST_CHECK(test_bag(&bag, 256, "{\"all\":[]}") == LJSON_ERROR_NONE);
+    TEST_CHECK((bag.all.count == 0) && (bag.all.buffer == 0));
+
+    /* the capacity stops at the bound, one more is over */
+    TEST_CHECK(test_bag(&bag, 256, "{\"few\":[1,2,3,4,5,6]}") == LJSON_ERROR_NONE);
+    TEST_CHECK((bag.few.count == 6) && (bag.few.size == 6) && (((int32_t *)bag.few.buffer)[5] == 6));
+#ifdef LJSON_ERROR_ARRAY_OVER_IGNORE
+    TEST_CHECK(test_bag(&bag, 256, "{\"few\":[1,2,3,4,5,6,7]}") == LJSON_ERROR_NONE);
+    TEST_CHECK((bag.few.count == 6) && (bag.few.size == 6) && (((int32_t *)bag.few.buffer)[5] == 6));
+#else
+    TEST_CHECK(test_bag(&bag, 256, "{\"few\":[1,2,3,4,5,6,7]}") == LJSON_ERROR_ARRAY_OVER);
+#endif
+
+    /* LJSON_VECTOR_SIZE elements fit, growing does not */
+    TEST_CHECK(test_bag(&bag, LJSON_VECTOR_SIZE * sizeof(int32_t), "{\"all\":[1,2,3,4]}") == LJSON_ERROR_NONE);
+    TEST_CHECK((bag.all.count == LJSON_VECTOR_SIZE) && (bag.all.size == LJSON_VECTOR_SIZE));
+    TEST_CHECK(test_bag(&bag, LJSON_VECTOR_SIZE * sizeof(int32_t), "{\"all\":[1,2,3,4,5]}") == LJSON_ERROR_ARENA_OVER);
+    TEST_CHECK(bag.all.count == LJSON_VECTOR_SIZE);
+    /* no arena at all */
+    TEST_CHECK(test_bag(&bag, 0, "{\"all\":[1]}") == LJSON_ERROR_ARENA_OVER);
+    TEST_CHECK(bag.all.count == 0);
+}
+
+////////////////////////////////////////
+
+/* a lone student_t */
+static const ljson_item_t test_student_top[] =
+{
+    { 0, LJSON_ITEM_OBJECT, countof(ljson_student), (void *)ljson_student },
+};
+
+static ljson_inst_t test_student_inst[16];
+static ljson_schema_t test_student_schema;
+
+static void test_want(void)
+{
+    const char text[] = "{\"name\":\"w\",\"old\":9,\"height\":1.5,\"boy\":true}";
+    student_t student;
+    ljson_parser_t parser;
+    ljson_contex_t contex;
+    uint8_t mask[LJSON_MASK_SIZE(16)];
+    uint8_t want[LJSON_MASK_SIZE(16)];
+
+    TEST_CHECK(ljson_schema_compile(&test_student_schema, test_student_inst, countof(test_student_inst), test_student_top) == LJSON_ERROR_NONE);
+    memset(want, 0, sizeof(want));
+    ljson_mask_set(want, ljson_schema_find(&test_student_schema, "name"));
+    ljson_mask_set(want, ljson_schema_find(&test_student_schema, "old"));
+
+    memset(&student, 0, sizeof(student));
+    ljson_contex_init(&contex, &test_student_schema, &student);
+    ljson_contex_track(&contex, mask, want);
+    ljson_parser_init(&parser, ljson_callback_default, &contex);
+    TEST_CHECK(ljson_parser_feed(&parser, text, sizeof(text) - 1) == LJSON_ERROR_DONE);
+    /* stopped at the ',' that ends the 9 */
+    TEST_CHECK(parser.used == (uint16_t)(strstr(text, ",\"height") - text));
+    TEST_CHECK((strcmp(student.name, "w") == 0) && (student.old == 9) && (student.height == 0) && (student.boy == 0));
+
+    /* no want: the whole text, the mask filled */
+    ljson_contex_init(&contex, &test_student_schema, &student);
+    ljson_contex_track(&contex, mask, 0);
+    TEST_CHECK(test_feed(&contex, text) == LJSON_ERROR_NONE);
+    TEST_CHECK((student.height == 1.5f) && (student.boy == 1));
+    TEST_CHECK(ljson_mask_get(mask, ljson_schema_find(&test_student_schema, "boy")) != 0);
+    TEST_CHECK(ljson_mask_get(mask, ljson_schema_find(&test_student_schema, "width")) == 0);
+}
+
+////////////////////////////////////////
+
+/* LJSON_ITEM_RAW as a value and as the items of arrays */
+typedef struct _test_raw
+{
+    char value[16];
+    char text[3][16];
+    uint32_t text_count;
+    ljson_raw_t span[3];
+    uint32_t span_count;
+} test_raw_t;
+
+static const ljson_item_t test_raw_text[] =
+{
+    { 0, LJSON_ITEM_RAW, sizeof(((test_raw_t *)0)->text[0]), LJSON_OFFSET(test_raw_t, text) },
+};
+
+static const ljson_item_t test_raw_span[] =
+{
+    { 0, LJSON_ITEM_RAW, 0, LJSON_OFFSET(test_raw_t, span) },
+};
+
+static const ljson_item_t test_raw_items[] =
+{
+    { "value", LJSON_ITEM_RAW, sizeof(((test_raw_t *)0)->value), LJSON_OFFSET(test_raw_t, value) },
+    { "text", LJSON_ITEM_ARRAY, 3, (void *)test_raw_text, sizeof(((test_raw_t *)0)->text[0]), LJSON_OFFSET(test_raw_t, text_count) },
+    { "span", LJSON_ITEM_ARRAY, 3, (void *)test_raw_span, sizeof(ljson_raw_t), LJSON_OFFSET(test_raw_t, span_count) },
+};
+
+static const ljson_item_t test_raw_top[] =
+{
+    { 0, LJSON_ITEM_OBJECT, countof(test_raw_items), (void *)test_raw_items },
+};
+
+static void test_raw(void)
+{
+    test_raw_t raw;
+    ljson_inst_t inst[16];
+    ljson_schema_t raw_schema;
+    ljson_contex_t contex;
+
+    TEST_CHECK(ljson_schema_compile(&raw_schema, inst, countof(inst), test_raw_top) == LJSON_ERROR_NONE);
+    memset(&raw, 0, sizeof(raw));
+    ljson_contex_init(&contex, &raw_schema, &raw);
+    TEST_CHECK(test_feed(&contex, "{\"value\": 12 ,\"text\":[1, \"a b\" ,{\"x\":[2]}],\"span\":[ true ,[3, 4]]}") == LJSON_ERROR_NONE);
+    /* whitespace around a token is not part of it */
+    TEST_CHECK(strcmp(raw.value, "12") == 0);
+    TEST_CHECK((raw.text_count == 3) && (strcmp(raw.text[0], "1") == 0) && (strcmp(raw.text[1], "\"a b\"") == 0)
+        && (strcmp(raw.text[2], "{\"x\":[2]}") == 0));
+    TEST_CHECK((raw.span_count == 2) && (raw.span[0].length == 4) && (memcmp(raw.span[0].buffer, "true", 4) == 0)
+        && (raw.span[1].length == 6) && (memcmp(raw.span[1].buffer, "[3, 4]", 6) == 0));
+
+    memset(&raw, 0, sizeof(raw));
+    ljson_contex_init(&contex, &raw_schema, &raw);
+    TEST_CHECK(test_feed(&contex, "{\"text\":[ ],\"value\":true}") == LJSON_ERROR_NONE);
+    TEST_CHECK((raw.text_count == 0) && (strcmp(raw.value, "true") == 0));
+}
+
+////////////////////////////////////////
+
+/* LJSON_MODE_PATCH over a bound document */
+typedef struct _test_class
+{
+    student_t teacher;
+    uint16_t mark[4];
+    uint32_t mark_count;
+} test_class_t;
+
+static const ljson_item_t test_class_mark[] =
+{
+    { 0, LJSON_ITEM_INTEGER, sizeof(uint16_t), LJSON_OFFSET(test_class_t, mark) },
+};
+
+static const ljson_item_t test_class_items[] =
+{
+    { "teacher", LJSON_ITEM_OBJECT, countof(ljson_student), (void *)ljson_student, offsetof(test_class_t, teacher) },
+    { "mark", LJSON_ITEM_ARRAY, 4, (void *)test_class_mark, sizeof(uint16_t), LJSON_OFFSET(test_class_t, mark_count) },
+};
+
+static const ljson_item_t test_class_top[] =
+{
+    { 0, LJSON_ITEM_OBJECT, countof(test_class_items), (void *)test_class_items },
+};
+
+static ljson_inst_t test_class_inst[16];
+static ljson_schema_t test_class_schema;
+
+static uint8_t test_class(test_class_t *klass, uint8_t mode, const char *text)
+{
+    ljson_contex_t contex;
+
+    ljson_contex_init(&contex, &test_class_schema, klass);
+    contex.mode = mode;
+
+    return test_feed(&contex, text);
+}
+
+static void test_patch(void)
+{
+    test_class_t klass;
+
+    TEST_CHECK(ljson_schema_compile(&test_class_schema, test_class_inst, countof(test_class_inst), test_class_top) == LJSON_ERROR_NONE);
+    memset(&klass, 0, sizeof(klass));
+    TEST_CHECK(test_class(&klass, 0, "{\"teacher\":{\"name\":\"t\",\"old\":40,\"boy\":true},\"mark\":[1,2,3]}") == LJSON_ERROR_NONE);
+    TEST_CHECK(klass.mark_count == 3);
+
+    /* objects merge, arrays are replaced */
+    TEST_CHECK(test_class(&klass, LJSON_MODE_PATCH, "{\"teacher\":{\"old\":41},\"mark\":[7]}") == LJSON_ERROR_NONE);
+    TEST_CHECK((strcmp(klass.teacher.name, "t") == 0) && (klass.teacher.old == 41) && (klass.teacher.boy == 1));
+    TEST_CHECK((klass.mark_count == 1) && (klass.mark[0] == 7) && (klass.mark[1] == 0) && (klass.mark[2] == 0));
+
+    /* null resets a subtree, the rest is kept */
+    TEST_CHECK(test_class(&klass, LJSON_MODE_PATCH, "{\"teacher\":null}") == LJSON_ERROR_NONE);
+    TEST_CHECK((klass.teacher.name[0] == '\0') && (klass.teacher.old == 0) && (klass.teacher.boy == 0));
+    TEST_CHECK((klass.mark_count == 1) && (klass.mark[0] == 7));
+    TEST_CHECK(test_class(&klass, LJSON_MODE_PATCH, "{\"mark\":null}") == LJSON_ERROR_NONE);
+    TEST_CHECK((klass.mark_count == 0) && (klass.mark[0] == 0));
+}
+
+////////////////////////////////////////
+
+/* keys as LJSON_TYPE_KEY_ID through ljson_dict_t */
+static const char *const test_dict_name[] = { "name", "old", "boy" };
+
+static uint16_t test_dict_id[8];
+static uint16_t test_dict_count;
+
+static uint8_t test_dict_callback(uint8_t type, uint8_t *buffer, uint16_t length, void *user)
+{
+    (void)buffer;
+    (void)user;
+    if ((type == LJSON_TYPE_KEY_ID) && (test_dict_count < countof(test_dict_id)))
+    {
+        test_dict_id[test_dict_count++] = length;
+    }
+    TEST_CHECK(type != LJSON_TYPE_KEY);
+
+    return LJSON_ERROR_NONE;
+}
+
+static void test_dict(void)
+{
+    const char text[] = "{\"old\":1,\"zzz\":2,\"b\\u006fy\":true,\"name\":\"d\"}";
+    student_t student;
+    ljson_dict_t dict;
+    uint16_t slot[8];
+    ljson_parser_t parser;
+    ljson_contex_t contex;
+
+    TEST_CHECK(ljson_dict_init(&dict, test_dict_name, countof(test_dict_name), slot, 3) == LJSON_ERROR_BUFFER_OVER);
+    TEST_CHECK(ljson_dict_init(&dict, test_dict_name, countof(test_dict_name), slot, countof(slot)) == LJSON_ERROR_NONE);
+    ljson_parser_init(&parser, test_dict_callback, 0);
+    parser.dict = &dict;
+    TEST_CHECK(ljson_parser_feed(&parser, text, sizeof(text) - 1) == LJSON_ERROR_NONE);
+    TEST_CHECK((test_dict_count == 4) && (test_dict_id[0] == 1) && (test_dict_id[1] == LJSON_KEY_NONE)
+        && (test_dict_id[2] == 2) && (test_dict_id[3] == 0));
+
+    /* ljson_callback_default matches ids by their text */
+    memset(&student, 0, sizeof(student));
+    ljson_contex_init(&contex, &test_student_schema, &student);
+    ljson_parser_init(&parser, ljson_callback_default, &contex);
+    parser.dict = &dict;
+    TEST_CHECK(ljson_parser_feed(&parser, text, sizeof(text) - 1) == LJSON_ERROR_NONE);
+    TEST_CHECK((student.old == 1) && (student.boy == 1) && (strcmp(student.name, "d") == 0));
+}
+
+////////////////////////////////////////
+
+/* reloads of test_class_t with ljson_contex_fingerprint */
+static uint8_t test_print_load(test_class_t *klass, uint32_t *print, uint8_t *change, const char *text)
+{
+    ljson_contex_t contex;
+
+    ljson_contex_init(&contex, &test_class_schema, klass);
+    ljson_contex_fingerprint(&contex, print, change);
+
+    return test_feed(&contex, text);
+}
+
+static void test_fingerprint(void)
+{
+    test_class_t klass;
+    uint32_t print[16];
+    uint8_t change[LJSON_MASK_SIZE(16)];
+    uint16_t old = ljson_schema_find(&test_class_schema, "teacher.old");
+    uint16_t name = ljson_schema_find(&test_class_schema, "teacher.name");
+    uint16_t mark = ljson_schema_find(&test_class_schema, "mark");
+    char path[32];
+
+    TEST_CHECK((old != LJSON_INST_NONE) && (name != LJSON_INST_NONE) && (mark != LJSON_INST_NONE));
+    memset(&klass, 0, sizeof(klass));
+    memset(print, 0, sizeof(print));
+    TEST_CHECK(test_print_load(&klass, print, change, "{\"teacher\":{\"name\":\"t\",\"old\":40},\"mark\":[1,2]}") == LJSON_ERROR_NONE);
+    TEST_CHECK(ljson_mask_get(change, old) && ljson_mask_get(change, name) && ljson_mask_get(change, mark));
+    TEST_CHECK((klass.teacher.old == 40) && (klass.mark_count == 2) && (klass.mark[1] == 2));
+
+    /* the same text again: nothing is bound, so the marks survive */
+    klass.teacher.old = 99;
+    klass.mark[0] = 99;
+    TEST_CHECK(test_print_load(&klass, print, change, "{\"teacher\":{\"name\":\"t\",\"old\":40},\"mark\":[1,2]}") == LJSON_ERROR_NONE);
+    TEST_CHECK(!ljson_mask_get(change, old) && !ljson_mask_get(change, name) && !ljson_mask_get(change, mark));
+    TEST_CHECK((klass.teacher.old == 99) && (klass.mark[0] == 99));
+
+    /* one leaf changed */
+    TEST_CHECK(test_print_load(&klass, print, change, "{\"teacher\":{\"name\":\"t\",\"old\":41},\"mark\":[1,2]}") == LJSON_ERROR_NONE);
+    TEST_CHECK(ljson_mask_get(change, old) && !ljson_mask_get(change, name) && !ljson_mask_get(change, mark));
+    TEST_CHECK((klass.teacher.old == 41) && (klass.mark[0] == 99));
+    TEST_CHECK((ljson_schema_path(&test_class_schema, old, path, sizeof(path)) > 0) && (strcmp(path, "teacher.old") == 0));
+}
+
+////////////////////////////////////////
+
+/* ljson_contex_write through a small block, gathered here */
+static char test_sink[512];
+static uint32_t test_sink_used;
+static uint16_t test_sink_calls;
+
+static uint8_t test_sink_flush(const void *buffer, uint16_t length, void *user)
+{
+    (void)user;
+    if (test_sink_used + length >= sizeof(test_sink))
+    {
+        return LJSON_ERROR_BUFFER_OVER;
+    }
+    memcpy(test_sink + test_sink_used, buffer, length);
+    test_sink_used += length;
+    test_sink[test_sink_used] = '\0';
+    test_sink_calls++;
+
+    return LJSON_ERROR_NONE;
+}
+
+static void test_writer(void)
+{
+    const char text[] = "{\"teacher\":{\"name\":\"t\\\"q\",\"old\":40,\"height\":1.5,\"width\":-0.25,\"boy\":true},\"mark\":[1,2]}";
+    test_class_t klass;
+    test_class_t again;
+    ljson_contex_t contex;
+    ljson_writer_t writer;
+    char block[7];
+    char buffer[256];
+    uint16_t length;
+
+    memset(&klass, 0, sizeof(klass));
+    TEST_CHECK(test_class(&klass, 0, text) == LJSON_ERROR_NONE);
+    ljson_contex_init(&contex, &test_class_schema, &klass);
+    length = ljson_contex_snprintf(&contex, buffer, sizeof(buffer), 0);
+    TEST_CHECK((length == sizeof(text) - 1) && (strcmp(buffer, text) == 0));
+
+    /* a block smaller than most values */
+    test_sink_used = 0;
+    test_sink_calls = 0;
+    ljson_writer_init(&writer, block, sizeof(block), test_sink_flush, 0);
+    ljson_contex_init(&contex, &test_class_schema, &klass);
+    TEST_CHECK(ljson_contex_write(&contex, &writer, 0) == LJSON_ERROR_NONE);
+    TEST_CHECK((writer.length == length) && (strcmp(test_sink, text) == 0) && (test_sink_calls == (length + sizeof(block) - 1) / sizeof(block)));
+
+    /* too small: the length still counted, the text cut */
+    ljson_contex_init(&contex, &test_class_schema, &klass);
+    TEST_CHECK(ljson_contex_snprintf(&contex, buffer, 11, 0) == length);
+    TEST_CHECK(strcmp(buffer, "{\"teacher\"") == 0);
+
+    /* pretty text reads back the same */
+    ljson_contex_init(&contex, &test_class_schema, &klass);
+    TEST_CHECK(ljson_contex_snprintf(&contex, buffer, sizeof(buffer), 1) > length);
+    memset(&again, 0, sizeof(again));
+    TEST_CHECK(test_class(&again, 0, buffer) == LJSON_ERROR_NONE);
+    TEST_CHECK(memcmp(&again, &klass, sizeof(klass)) == 0);
+}
+
+////////////////////////////////////////
+
+/* escapes at the edges of the 16 and 32 byte scans, whole and cut, against a byte at a time */
+static uint16_t test_escape_one(char *dst, const char *src, uint16_t length)
+{
+    uint16_t n = 0;
+    uint16_t i;
+
+    dst[n++] = '"';
+    for (i = 0; i < length; i++)
+    {
+        switch (src[i])
+        {
+        case '"': n += sprintf(dst + n, "\\\""); break;
+        case '\\': n += sprintf(dst + n, "\\\\"); break;
+        case '\b': n += sprintf(dst + n, "\\b"); break;
+        case '\f': n += sprintf(dst + n, "\\f"); break;
+        case '\n': n += sprintf(dst + n, "\\n"); break;
+        case '\r': n += sprintf(dst + n, "\\r"); break;
+        case '\t': n += sprintf(dst + n, "\\t"); break;
+        default:
+            if (((uint8_t)src[i] < 0x20) || ((uint8_t)src[i] == 0x7F))
+            {
+                n += sprintf(dst + n, "\\u%04x", (uint8_t)src[i]);
+            }
+            else
+            {
+                dst[n++] = src[i];
+            }
+            break;
+        }
+    }
+    dst[n++] = '"';
+    dst[n] = '\0';
+
+    return n;
+}
+
+static void test_escape(void)
+{
+    static const char special[] = { '"', '\\', '\n', 0x01, 0x1F, 0x7F };
+    static const uint8_t offset[] = { 0, 15, 16, 17, 31, 32, 33, 47 };
+    char text[48];
+    char expect[48 * 6 + 3];
+    char buffer[sizeof(expect)];
+    uint16_t length;
+    uint16_t size;
+    uint16_t cut;
+    uint16_t fail = 0;
+    uint16_t i;
+    uint16_t j;
+    uint16_t k;
+
+    for (i = 0; i < sizeof(special); i++)
+    {
+        for (j = 0; j < sizeof(offset); j++)
+        {
+            memset(text, 'a' + j, sizeof(text));
+            text[offset[j]] = special[i];
+            text[(offset[j] + 16) % sizeof(text)] = special[(i + 1) % sizeof(special)];
+            length = test_escape_one(expect, text, sizeof(text));
+            for (size = 1; size <= length + 1; size++)
+            {
+                /* a cut \u00XX keeps only its '\\' */
+                cut = size - 1;
+                for (k = 0; (k < cut) && (cut < length); k++)
+                {
+                    if ((expect[k] == '\\') && (expect[k + 1] == 'u') && (cut < k + 6))
+                    {
+                        cut = k + 1;
+                        break;
+                    }
+                    k += (expect[k] == '\\');
+                }
+                if (cut > length)
+                {
+                    cut = length;
+                }
+                if ((snprintf_string(buffer, size, text, sizeof(text)) != length) || (strlen(buffer) != cut) || (memcmp(buffer, expect, cut) != 0))
+                {
+                    printf("escape 0x%02x at %u cut to %u: %s\n", (uint8_t)special[i], offset[j], size, buffer);
+                    fail++;
+                }
+            }
+        }
+    }
+    TEST_CHECK(fail == 0);
+
+    /* "null" whole or not at all */
+    TEST_CHECK((snprintf_string(buffer, 4, "", 0) == 4) && (buffer[0] == '\0'));
+    TEST_CHECK((snprintf_string(buffer, 5, "", 0) == 4) && (strcmp(buffer, "null") == 0));
+}
+
+////////////////////////////////////////
+
+/* LJSON_ITEM_CALLBACK writing an array one element per call */
+typedef struct _test_produce
+{
+    int32_t n;
+} test_produce_t;
+
+static uint32_t test_produce_count;     /* elements, 0 writes nothing */
+static uint8_t test_produce_error;      /* returned by the third call */
+static uint32_t test_produce_calls;
+static uint32_t test_produce_wrong;     /* calls with length or ljson_writer_t.call off */
+
+static uint8_t test_produce(uint8_t type, uint8_t *buffer, uint16_t length, void *user)
+{
+    ljson_writer_t *writer = (ljson_writer_t *)buffer;
+    uint32_t call = writer->call;
+
+    (void)user;
+    test_produce_wrong += (call != test_produce_calls) || (length != ((call < 0xFFFF) ? call : 0xFFFF));
+    test_produce_calls++;
+    if ((test_produce_error != LJSON_ERROR_NONE) && (call == 2))
+    {
+        return test_produce_error;
+    }
+    if (test_produce_count == 0)
+    {
+        return LJSON_ERROR_NONE;
+    }
+    if (type == LJSON_TYPE_WRITE_CBOR)
+    {
+        if (call == 0)
+        {
+            ljson_cbor_head(writer, LJSON_CBOR_ARRAY, test_produce_count);
+        }
+        ljson_cbor_integer(writer, call);
+    }
+    else
+    {
+        ljson_writer_write(writer, (call == 0) ? "[" : ",", 1);
+        if (call & 1)
+        {
+            ljson_writer_real(writer, call + 0.5);
+        }
+        else
+        {
+            ljson_writer_integer(writer, call);
+        }
+        if (call + 1 == test_produce_count)
+        {
+            ljson_writer_write(writer, "]", 1);
+        }
+    }
+
+    return (call + 1 < test_produce_count) ? LJSON_ERROR_MORE : LJSON_ERROR_NONE;
+}
+
+static const ljson_item_t test_produce_items[] =
+{
+    { "n", LJSON_ITEM_INTEGER, sizeof(int32_t), LJSON_OFFSET(test_produce_t, n) },
+    { "list", LJSON_ITEM_CALLBACK, 0, test_produce },
+};
+
+static const ljson_item_t test_produce_top[] =
+{
+    { 0, LJSON_ITEM_OBJECT, countof(test_produce_items), (void *)test_produce_items },
+};
+
+static void test_produce_reset(uint32_t count, uint8_t error)
+{
+    test_produce_count = count;
+    test_produce_error = error;
+    test_produce_calls = 0;
+    test_produce_wrong = 0;
+}
+
+static void test_producer(void)
+{
+    static const char expect[] = "{\"n\":1,\"list\":[0,1.5,2]}";
+    test_produce_t produce;
+    ljson_inst_t inst[4];
+    ljson_schema_t schema;
+    ljson_contex_t contex;
+    ljson_writer_t writer;
+    char block[7];
+    char buffer[512];
+    uint16_t length;
+
+    produce.n = 1;
+    TEST_CHECK(ljson_schema_compile(&schema, inst, countof(inst), test_produce_top) == LJSON_ERROR_NONE);
+
+    /* nothing written is null */
+    test_produce_reset(0, LJSON_ERROR_NONE);
+    ljson_contex_init(&contex, &schema, &produce);
+    TEST_CHECK((ljson_contex_snprintf(&contex, buffer, sizeof(buffer), 0) == 19) && (strcmp(buffer, "{\"n\":1,\"list\":null}") == 0));
+    TEST_CHECK((test_produce_calls == 1) && (test_produce_wrong == 0));
+
+    /* called again for each LJSON_ERROR_MORE */
+    test_produce_reset(3, LJSON_ERROR_NONE);
+    ljson_contex_init(&contex, &schema, &produce);
+    TEST_CHECK((ljson_contex_snprintf(&contex, buffer, sizeof(buffer), 0) == sizeof(expect) - 1) && (strcmp(buffer, expect) == 0));
+    TEST_CHECK((test_produce_calls == 3) && (test_produce_wrong == 0));
+
+    /* the array across many flushes of a small block */
+    test_produce_reset(60, LJSON_ERROR_NONE);
+    ljson_contex_init(&contex, &schema, &produce);
+    length = ljson_contex_snprintf(&contex, buffer, sizeof(buffer), 0);
+    TEST_CHECK(length < sizeof(buffer));
+    test_sink_used = 0;
+    test_sink_calls = 0;
+    test_produce_reset(60, LJSON_ERROR_NONE);
+    ljson_writer_init(&writer, block, sizeof(block), test_sink_flush, 0);
+    ljson_contex_init(&contex, &schema, &produce);
+    TEST_CHECK(ljson_contex_write(&contex, &writer, 0) == LJSON_ERROR_NONE);
+    TEST_CHECK((writer.length == length) && (strcmp(test_sink, buffer) == 0) && (test_sink_calls == (length + sizeof(block) - 1) / sizeof(block)));
+    TEST_CHECK((test_produce_calls == 60) && (test_produce_wrong == 0));
+
+    /* an error ends the output where it is */
+    test_produce_reset(60, LJSON_ERROR_BUFFER_OVER);
+    ljson_writer_init(&writer, buffer, sizeof(buffer) - 1, 0, 0);
+    ljson_contex_init(&contex, &schema, &produce);
+    TEST_CHECK(ljson_contex_write(&contex, &writer, 0) == LJSON_ERROR_BUFFER_OVER);
+    buffer[writer.used] = '\0';
+    TEST_CHECK((strcmp(buffer, "{\"n\":1,\"list\":[0,1.5") == 0) && (test_produce_calls == 3));
+
+    /* more calls than a uint16_t counts, only counted */
+    test_produce_reset(70000, LJSON_ERROR_NONE);
+    ljson_writer_init(&writer, buffer, sizeof(buffer), 0, 0);
+    ljson_contex_init(&contex, &schema, &produce);
+    TEST_CHECK((ljson_contex_write(&contex, &writer, 0) == LJSON_ERROR_NONE) && (writer.length > 0xFFFF));
+    TEST_CHECK((test_produce_calls == 70000) && (test_produce_wrong == 0));
+    /* map head, "n", 1, "list", array head, then 24 + 232 + 65280 + 4464 integers of 1, 2, 3 and 5 bytes */
+    test_produce_reset(70000, LJSON_ERROR_NONE);
+    ljson_writer_init(&writer, buffer, sizeof(buffer), 0, 0);
+    ljson_contex_init(&contex, &schema, &produce);
+    TEST_CHECK((ljson_cbor_write(&contex, &writer) == LJSON_ERROR_NONE) && (writer.length == 1 + 2 + 1 + 5 + 5 + 24 + 232 * 2 + 65280 * 3 + 4464 * 5));
+    TEST_CHECK((test_produce_calls == 70000) && (test_produce_wrong == 0));
+}
+
+////////////////////////////////////////
+
+/* reals written with snprintf_real read back bit for bit */
+static uint8_t test_real_trip(double value)
+{
+    char text[64];
+    double back = 0;
+    float single = (float)value;
+    float single_back = 0;
+
+    snprintf_real(text, sizeof(text), &value, sizeof(value));
+    if ((str_to_exp(text, &back, sizeof(back)) != strlen(text)) || (memcmp(&back, &value, sizeof(value)) != 0))
+    {
+        printf("real %.17g as %s\n", value, text);
+        return 0;
+    }
+    if (single - single != 0)
+    {
+        /* out of the range of a float */
+        return 1;
+    }
+    snprintf_real(text, sizeof(text), &single, sizeof(single));
+    str_to_exp(text, &single_back, sizeof(single_back));
+    if (memcmp(&single_back, &single, sizeof(single)) != 0)
+    {
+        printf("real %.9g as %s\n", single, text);
+        return 0;
+    }
+
+    return 1;
+}
+
+static void test_real(void)
+{
+    static const double edge[] =
+    {
+        0.0, -0.0, 0.1, 0.3, 0.1 + 0.2, 1.0 / 3, 163.2, 1e21, 1e22, 123456789012345678.0,
+        5e-324, 2.2250738585072014e-308, 2.2250738585072009e-308, 1.7976931348623157e308, 9007199254740993.0,
+    };
+    static const char *const comma[] = { "de_DE.UTF-8", "de_DE.utf8", "de_DE", "fr_FR.UTF-8", "ru_RU.UTF-8", "German" };
+    uint64_t bits = 0x9E3779B97F4A7C15ULL;
+    double value;
+    double back;
+    uint16_t fail = 0;
+    uint32_t i;
+
+    for (i = 0; i < countof(edge); i++)
+    {
+        fail += !test_real_trip(edge[i]);
+        fail += !test_real_trip(-edge[i]);
+    }
+    for (i = 0; i < 100000; i++)
+    {
+        /* xorshift over the bit patterns, no inf or nan */
+        bits ^= bits << 13;
+        bits ^= bits >> 7;
+        bits ^= bits << 17;
+        memcpy(&value, &bits, sizeof(value));
+        if (value - value == 0)
+        {
+            fail += !test_real_trip(value);
+        }
+    }
+    TEST_CHECK(fail == 0);
+
+    /* text with more digits than a double holds, rounded once */
+    TEST_CHECK((str_to_exp("0.1000000000000000055511151231257827021181583404541015625", &back, sizeof(back)) == 57) && (back == 0.1));
+    TEST_CHECK((str_to_exp("2.2250738585072011e-308", &back, sizeof(back)) == 23) && (back == 2.2250738585072011e-308));
+    TEST_CHECK((str_to_exp("-12.5E+2,", &back, sizeof(back)) == 8) && (back == -1250));
+    TEST_CHECK((str_to_real("7.25e3", &back, sizeof(back)) == 4) && (back == 7.25));
+
+    /* '.' whatever the decimal point of LC_NUMERIC, when a comma locale is installed */
+    for (i = 0; i < countof(comma); i++)
+    {
+        if (setlocale(LC_NUMERIC, comma[i]) != 0)
+        {
+            TEST_CHECK((str_to_real("163.25", &back, sizeof(back)) == 6) && (back == 163.25));
+            TEST_CHECK((str_to_exp("-1.5e-3", &back, sizeof(back)) == 7) && (back == -1.5e-3));
+            TEST_CHECK(test_real_trip(0.1 + 0.2));
+            setlocale(LC_NUMERIC, "C");
+            break;
+        }
+    }
+}
+
+////////////////////////////////////////
+
+/* ljson_serializer_write gives what ljson_contex_write does */
+static uint8_t test_serial_same(const ljson_schema_t *schema, void *base)
+{
+    static char expect[8192];
+    static char text[8192];
+    char block[256];
+    uint16_t offset[64];
+    ljson_serializer_t serializer;
+    ljson_contex_t contex;
+    ljson_writer_t writer;
+    uint16_t length;
+
+    if (ljson_serializer_compile(&serializer, schema, offset, block, sizeof(block)) != LJSON_ERROR_NONE)
+    {
+        return 0;
+    }
+    ljson_contex_init(&contex, schema, base);
+    length = ljson_contex_snprintf(&contex, expect, sizeof(expect), 0);
+    ljson_contex_init(&contex, schema, base);
+    ljson_writer_init(&writer, text, sizeof(text) - 1, 0, 0);
+    if (ljson_serializer_write(&serializer, &contex, &writer) != LJSON_ERROR_NONE)
+    {
+        return 0;
+    }
+    text[writer.used] = '\0';
+
+    return (writer.length == length) && (strcmp(text, expect) == 0);
+}
+
+static void test_serializer(void)
+{
+    test_class_t klass;
+    test_shape_t shape;
+    ljson_serializer_t serializer;
+    uint16_t offset[16];
+    char block[16];
+
+    memset(&klass, 0, sizeof(klass));
+    TEST_CHECK(test_serial_same(&test_class_schema, &klass));
+    TEST_CHECK(test_class(&klass, 0, "{\"teacher\":{\"name\":\"a\\nb\",\"old\":3,\"width\":0.5},\"mark\":[4,5,6]}") == LJSON_ERROR_NONE);
+    TEST_CHECK(test_serial_same(&test_class_schema, &klass));
+    TEST_CHECK(test_serial_same(&schema, &school));
+    TEST_CHECK(test_shape(&shape, "{\"type\":\"point\",\"body\":{\"x\":1,\"y\":2}}") == LJSON_ERROR_NONE);
+    TEST_CHECK(test_serial_same(&test_shape_schema, &shape));
+    TEST_CHECK(ljson_serializer_compile(&serializer, &test_class_schema, offset, block, sizeof(block)) == LJSON_ERROR_BUFFER_OVER);
+}
+
+////////////////////////////////////////
+
+/* number arrays written at once without fmt, the same as one by one with it */
+typedef struct _test_numbers
+{
+    int8_t i8[5];
+    int16_t i16[5];
+    int32_t i32[5];
+    int64_t i64[5];
+    uint8_t u8[5];
+    uint16_t u16[5];
+    uint32_t u32[5];
+    uint64_t u64[5];
+    float f32[5];
+    double f64[5];
+    double grid[10][10];
+} test_numbers_t;
+
+#define TEST_NUMBERS_ITEM(field, kind) \
+    static const ljson_item_t test_numbers_##field[] = { { 0, kind, sizeof(((test_numbers_t *)0)->field[0]), LJSON_OFFSET(test_numbers_t, field) } }
+TEST_NUMBERS_ITEM(i8, LJSON_ITEM_INTEGER);
+TEST_NUMBERS_ITEM(i16, LJSON_ITEM_INTEGER);
+TEST_NUMBERS_ITEM(i32, LJSON_ITEM_INTEGER);
+TEST_NUMBERS_ITEM(i64, LJSON_ITEM_INTEGER);
+TEST_NUMBERS_ITEM(u8, LJSON_ITEM_UNSIGNED);
+TEST_NUMBERS_ITEM(u16, LJSON_ITEM_UNSIGNED);
+TEST_NUMBERS_ITEM(u32, LJSON_ITEM_UNSIGNED);
+TEST_NUMBERS_ITEM(u64, LJSON_ITEM_UNSIGNED);
+TEST_NUMBERS_ITEM(f32, LJSON_ITEM_REAL);
+TEST_NUMBERS_ITEM(f64, LJSON_ITEM_REAL);
+
+static const ljson_item_t test_numbers_cell[] =
+{
+    { 0, LJSON_ITEM_REAL, sizeof(double), LJSON_OFFSET(test_numbers_t, grid) },
+};
+
+static const ljson_item_t test_numbers_row[] =
+{
+    { 0, LJSON_ITEM_ARRAY, 10, (void *)test_numbers_cell, sizeof(double) },
+};
+
+#define TEST_NUMBERS_ARRAY(field) \
+    { #field, LJSON_ITEM_ARRAY, 5, (void *)test_numbers_##field, sizeof(((test_numbers_t *)0)->field[0]) }
+
+static const ljson_item_t test_numbers_items[] =
+{
+    TEST_NUMBERS_ARRAY(i8), TEST_NUMBERS_ARRAY(i16), TEST_NUMBERS_ARRAY(i32), TEST_NUMBERS_ARRAY(i64),
+    TEST_NUMBERS_ARRAY(u8), TEST_NUMBERS_ARRAY(u16), TEST_NUMBERS_ARRAY(u32), TEST_NUMBERS_ARRAY(u64),
+    TEST_NUMBERS_ARRAY(f32), TEST_NUMBERS_ARRAY(f64),
+    { "grid", LJSON_ITEM_ARRAY, 10, (void *)test_numbers_row, sizeof(double) * 10 },
+};
+
+static const ljson_item_t test_numbers_top[] =
+{
+    { 0, LJSON_ITEM_OBJECT, countof(test_numbers_items), (void *)test_numbers_items },
+};
+
+static char test_numbers_sink[8192];
+static uint32_t test_numbers_used;
+
+static uint8_t test_numbers_flush(const void *buffer, uint16_t length, void *user)
+{
+    (void)user;
+    if (test_numbers_used + length >= sizeof(test_numbers_sink))
+    {
+        return LJSON_ERROR_BUFFER_OVER;
+    }
+    memcpy(test_numbers_sink + test_numbers_used, buffer, length);
+    test_numbers_used += length;
+    test_numbers_sink[test_numbers_used] = '\0';
+
+    return LJSON_ERROR_NONE;
+}
+
+static void test_numbers(void)
+{
+    static test_numbers_t numbers;
+    static test_numbers_t back;
+    static char fast[8192];
+    static char slow[8192];
+    ljson_inst_t inst[32];
+    ljson_schema_t schema;
+    ljson_contex_t contex;
+    ljson_writer_t writer;
+    char block[40];
+    uint16_t length;
+    uint16_t i;
+    uint16_t j;
+
+    TEST_CHECK(ljson_schema_compile(&schema, inst, countof(inst), test_numbers_top) == LJSON_ERROR_NONE);
+    for (i = 0; i < 5; i++)
+    {
+        /* the ends of each width and a few between */
+        numbers.i8[i] = (int8_t)((i == 0) ? -128 : (i == 4) ? 127 : (i - 2) * 50);
+        numbers.i16[i] = (int16_t)((i == 0) ? -32768 : (i == 4) ? 32767 : (i - 2) * 12345);
+        numbers.i32[i] = (i == 0) ? (int32_t)0x80000000 : (i == 4) ? 0x7FFFFFFF : (int32_t)(i - 2) * 123456789;
+        numbers.i64[i] = (i == 0) ? (int64_t)0x8000000000000000ULL : (i == 4) ? 0x7FFFFFFFFFFFFFFFLL : (int64_t)(i - 2) * 1234567890123LL;
+        numbers.u8[i] = (uint8_t)(i * 63);
+        numbers.u16[i] = (uint16_t)(i * 16383);
+        numbers.u32[i] = (i == 4) ? 0xFFFFFFFF : i * 1000000007U;
+        numbers.u64[i] = (i == 4) ? 0xFFFFFFFFFFFFFFFFULL : i * 10000000000000000007ULL / 4;
+        numbers.f32[i] = (float)((i - 2) * 0.1f);
+        numbers.f64[i] = (i == 0) ? -1e300 : (i == 4) ? 5e-324 : (i - 2) / 3.0;
+    }
+    for (i = 0; i < 10; i++)
+    {
+        for (j = 0; j < 10; j++)
+        {
+            numbers.grid[i][j] = (i * 10 + j) * 0.25 - 12.5;
+        }
+    }
+
+    /* fmt writes one by one, its text without the spaces is the same */
+    ljson_contex_init(&contex, &schema, &numbers);
+    length = ljson_contex_snprintf(&contex, fast, sizeof(fast), 0);
+    ljson_contex_init(&contex, &schema, &numbers);
+    TEST_CHECK(ljson_contex_snprintf(&contex, slow, sizeof(slow), 1) > length);
+    for (i = 0, j = 0; slow[i] != '\0'; i++)
+    {
+        if ((slow[i] != ' ') && (slow[i] != '\t') && (slow[i] != '\r') && (slow[i] != '\n'))
+        {
+            slow[j++] = slow[i];
+        }
+    }
+    slow[j] = '\0';
+    TEST_CHECK((length < sizeof(fast)) && (strcmp(fast, slow) == 0));
+
+    /* a block too small to take most numbers in place */
+    test_numbers_used = 0;
+    ljson_writer_init(&writer, block, sizeof(block), test_numbers_flush, 0);
+    ljson_contex_init(&contex, &schema, &numbers);
+    TEST_CHECK(ljson_contex_write(&contex, &writer, 0) == LJSON_ERROR_NONE);
+    TEST_CHECK((writer.length == length) && (strcmp(test_numbers_sink, fast) == 0));
+    TEST_CHECK(test_serial_same(&schema, &numbers));
+
+    /* and it reads back */
+    ljson_contex_init(&contex, &schema, &back);
+    TEST_CHECK(test_feed(&contex, fast) == LJSON_ERROR_NONE);
+    TEST_CHECK(memcmp(&back, &numbers, sizeof(back)) == 0);
+}
+
+////////////////////////////////////////
+
+/* ljson_schema_select with ljson_contex_project */
+static void test_project(void)
+{
+    test_class_t klass;
+    ljson_contex_t contex;
+    uint8_t mask[LJSON_MASK_SIZE(16)];
+    char buffer[128];
+
+    memset(&klass, 0, sizeof(klass));
+    TEST_CHECK(test_class(&klass, 0, "{\"teacher\":{\"name\":\"p\",\"old\":5,\"boy\":true},\"mark\":[8,9]}") == LJSON_ERROR_NONE);
+    TEST_CHECK(ljson_schema_select(&test_class_schema, mask, "teacher.old,mark") == LJSON_ERROR_NONE);
+    ljson_contex_init(&contex, &test_class_schema, &klass);
+    ljson_contex_project(&contex, mask);
+    ljson_contex_snprintf(&contex, buffer, sizeof(buffer), 0);
+    TEST_CHECK(strcmp(buffer, "{\"teacher\":{\"old\":5},\"mark\":[8,9]}") == 0);
+
+    TEST_CHECK(ljson_schema_select(&test_class_schema, mask, "teacher") == LJSON_ERROR_NONE);
+    ljson_contex_init(&contex, &test_class_schema, &klass);
+    ljson_contex_project(&contex, mask);
+    ljson_contex_snprintf(&contex, buffer, sizeof(buffer), 0);
+    TEST_CHECK(strcmp(buffer, "{\"teacher\":{\"name\":\"p\",\"old\":5,\"height\":0,\"width\":0,\"boy\":true}}") == 0);
+
+    TEST_CHECK(ljson_schema_select(&test_class_schema, mask, "teacher.age") == LJSON_ERROR_ITEM_MISS);
+}
+
+////////////////////////////////////////
+
+/* ljson_diff, and the patch it writes applied with LJSON_MODE_PATCH */
+static void test_diff(void)
+{
+    const char text[] = "{\"teacher\":{\"name\":\"d\",\"old\":5,\"boy\":true},\"mark\":[8,9]}";
+    test_class_t before;
+    test_class_t after;
+    uint8_t dirty[LJSON_MASK_SIZE(16)];
+    ljson_writer_t writer;
+    char buffer[128];
+
+    memset(&before, 0, sizeof(before));
+    TEST_CHECK(test_class(&before, 0, text) == LJSON_ERROR_NONE);
+    after = before;
+
+    /* nothing changed */
+    ljson_writer_init(&writer, buffer, sizeof(buffer) - 1, 0, 0);
+    TEST_CHECK(ljson_diff(&test_class_schema, &before, &after, dirty, &writer) == LJSON_ERROR_NONE);
+    buffer[writer.used] = '\0';
+    TEST_CHECK(strcmp(buffer, "{}") == 0);
+
+    after.teacher.old = 6;
+    after.mark[2] = 10;
+    after.mark_count = 3;
+    ljson_writer_init(&writer, buffer, sizeof(buffer) - 1, 0, 0);
+    TEST_CHECK(ljson_diff(&test_class_schema, &before, &after, dirty, &writer) == LJSON_ERROR_NONE);
+    buffer[writer.used] = '\0';
+    TEST_CHECK(strcmp(buffer, "{\"teacher\":{\"old\":6},\"mark\":[8,9,10]}") == 0);
+    TEST_CHECK(test_class(&before, LJSON_MODE_PATCH, buffer) == LJSON_ERROR_NONE);
+    TEST_CHECK(memcmp(&before, &after, sizeof(after)) == 0);
+}
+
+////////////////////////////////////////
+
+/* ljson_schema_touch and ljson_contex_compare on their own, three objects deep */
+typedef struct _test_at
+{
+    int32_t x;
+    int32_t y;
+} test_at_t;
+
+typedef struct _test_inner
+{
+    test_at_t at;
+    char tag[8];
+} test_inner_t;
+
+typedef struct _test_nest
+{
+    test_inner_t inner;
+    int32_t top;
+    uint16_t mark[2];
+} test_nest_t;
+
+static const ljson_item_t test_nest_at[] =
+{
+    { "x", LJSON_ITEM_INTEGER, sizeof(int32_t), LJSON_OFFSET(test_at_t, x) },
+    { "y", LJSON_ITEM_INTEGER, sizeof(int32_t), LJSON_OFFSET(test_at_t, y) },
+};
+
+static const ljson_item_t test_nest_inner[] =
+{
+    { "at", LJSON_ITEM_OBJECT, countof(test_nest_at), (void *)test_nest_at, offsetof(test_inner_t, at) },
+    { "tag", LJSON_ITEM_STRING, sizeof(((test_inner_t *)0)->tag), LJSON_OFFSET(test_inner_t, tag) },
+};
+
+static const ljson_item_t test_nest_mark[] =
+{
+    { 0, LJSON_ITEM_INTEGER, sizeof(uint16_t), LJSON_OFFSET(test_nest_t, mark) },
+};
+
+static const ljson_item_t test_nest_items[] =
+{
+    { "inner", LJSON_ITEM_OBJECT, countof(test_nest_inner), (void *)test_nest_inner, offsetof(test_nest_t, inner) },
+    { "top", LJSON_ITEM_INTEGER, sizeof(int32_t), LJSON_OFFSET(test_nest_t, top) },
+    { "mark", LJSON_ITEM_ARRAY, 2, (void *)test_nest_mark, sizeof(uint16_t) },
+};
+
+static const ljson_item_t test_nest_top[] =
+{
+    { 0, LJSON_ITEM_OBJECT, countof(test_nest_items), (void *)test_nest_items },
+};
+
+/* the merge patch of what dirty marks, or of what differs from snapshot if there is one */
+static uint16_t test_nest_patch(const ljson_schema_t *schema, test_nest_t *nest, const test_nest_t *snapshot, uint8_t *dirty, char *buffer, uint16_t size)
+{
+    ljson_contex_t contex;
+
+    ljson_contex_init(&contex, schema, nest);
+    if ((snapshot != 0) && (ljson_contex_compare(&contex, dirty, snapshot) != LJSON_ERROR_NONE))
+    {
+        return 0;
+    }
+    ljson_contex_project(&contex, dirty);
+
+    return ljson_contex_snprintf(&contex, buffer, size, 0);
+}
+
+static void test_touch(void)
+{
+    test_nest_t nest;
+    test_nest_t snapshot;
+    ljson_inst_t inst[16];
+    ljson_schema_t schema;
+    uint8_t dirty[LJSON_MASK_SIZE(16)];
+    uint8_t none[LJSON_MASK_SIZE(16)];
+    char buffer[128];
+    uint16_t x;
+    uint16_t mark;
+
+    TEST_CHECK(ljson_schema_compile(&schema, inst, countof(inst), test_nest_top) == LJSON_ERROR_NONE);
+    memset(&nest, 0, sizeof(nest));
+    nest.inner.at.x = 1;
+    nest.inner.at.y = 2;
+    strcpy(nest.inner.tag, "a");
+    nest.top = 3;
+    nest.mark[0] = 4;
+    nest.mark[1] = 5;
+    snapshot = nest;
+    x = ljson_schema_find(&schema, "inner.at.x");
+    mark = ljson_schema_find(&schema, "mark");
+    TEST_CHECK((x != LJSON_INST_NONE) && (mark != LJSON_INST_NONE));
+    memset(none, 0, sizeof(none));
+
+    /* a leaf is marked alone, the objects around it come with it */
+    memset(dirty, 0, sizeof(dirty));
+    ljson_schema_touch(&schema, dirty, x);
+    TEST_CHECK(ljson_mask_get(dirty, x) && !ljson_mask_get(dirty, x + 1));
+    TEST_CHECK(test_nest_patch(&schema, &nest, 0, dirty, buffer, sizeof(buffer)) > 0);
+    TEST_CHECK(strcmp(buffer, "{\"inner\":{\"at\":{\"x\":1}}}") == 0);
+    /* an array item marks the array, sent whole */
+    memset(dirty, 0, sizeof(dirty));
+    ljson_schema_touch(&schema, dirty, schema.inst[mark].child);
+    TEST_CHECK(ljson_mask_get(dirty, mark) && ljson_mask_get(dirty, schema.inst[mark].child) && !ljson_mask_get(dirty, x));
+    TEST_CHECK(test_nest_patch(&schema, &nest, 0, dirty, buffer, sizeof(buffer)) > 0);
+    TEST_CHECK(strcmp(buffer, "{\"mark\":[4,5]}") == 0);
+
+    /* nothing differs: nothing marked, an empty patch */
+    memset(dirty, 0, sizeof(dirty));
+    TEST_CHECK(test_nest_patch(&schema, &nest, &snapshot, dirty, buffer, sizeof(buffer)) > 0);
+    TEST_CHECK((memcmp(dirty, none, sizeof(dirty)) == 0) && (strcmp(buffer, "{}") == 0));
+
+    /* the deepest field and one at the top */
+    nest.inner.at.y = 7;
+    nest.top = 8;
+    memset(dirty, 0, sizeof(dirty));
+    TEST_CHECK(test_nest_patch(&schema, &nest, &snapshot, dirty, buffer, sizeof(buffer)) > 0);
+    TEST_CHECK(!ljson_mask_get(dirty, x) && ljson_mask_get(dirty, x + 1));
+    TEST_CHECK(strcmp(buffer, "{\"inner\":{\"at\":{\"y\":7}},\"top\":8}") == 0);
+
+    /* a string in the middle object, and one array item */
+    nest = snapshot;
+    strcpy(nest.inner.tag, "b");
+    nest.mark[1] = 6;
+    memset(dirty, 0, sizeof(dirty));
+    TEST_CHECK(test_nest_patch(&schema, &nest, &snapshot, dirty, buffer, sizeof(buffer)) > 0);
+    TEST_CHECK(strcmp(buffer, "{\"inner\":{\"tag\":\"b\"},\"mark\":[4,6]}") == 0);
+}
+
+////////////////////////////////////////
+
+/* arrays split over ljson_pool_t, the same text as one thread writes */
+typedef struct _test_crowd
+{
+    char name[8];
+    test_point_t point[1000];
+    uint32_t point_count;
+    int32_t tail[3];
+    uint32_t tail_count;
+} test_crowd_t;
+
+static const ljson_item_t test_crowd_point[] =
+{
+    { 0, LJSON_ITEM_OBJECT, countof(test_point_items), (void *)test_point_items, offsetof(test_crowd_t, point) },
+};
+
+static const ljson_item_t test_crowd_tail[] =
+{
+    { 0, LJSON_ITEM_INTEGER, sizeof(int32_t), LJSON_OFFSET(test_crowd_t, tail) },
+};
+
+static const ljson_item_t test_crowd_items[] =
+{
+    { "name", LJSON_ITEM_STRING, sizeof(((test_crowd_t *)0)->name), LJSON_OFFSET(test_crowd_t, name) },
+    { "point", LJSON_ITEM_ARRAY, 1000, (void *)test_crowd_point, sizeof(test_point_t), LJSON_OFFSET(test_crowd_t, point_count) },
+    { "tail", LJSON_ITEM_ARRAY, 3, (void *)test_crowd_tail, sizeof(int32_t), LJSON_OFFSET(test_crowd_t, tail_count) },
+};
+
+static const ljson_item_t test_crowd_top[] =
+{
+    { 0, LJSON_ITEM_OBJECT, countof(test_crowd_items), (void *)test_crowd_items },
+};
+
+static ljson_inst_t test_crowd_inst[16];
+static ljson_schema_t test_crowd_schema;
+static test_crowd_t test_crowd;
+static char test_crowd_text[32768];
+
+static void test_parallel(void)
+{
+    static char text[32768];
+    static char slab[32768];
+    static ljson_part_t part[4];
+    static const uint32_t count[] = { 1000, 0, 1, 63, 64, 300 };
+    static const uint32_t size[] = { sizeof(slab), 1000 };
+    ljson_pool_t pool;
+    ljson_contex_t contex;
+    ljson_writer_t writer;
+    uint16_t item;
+    uint32_t i;
+    uint32_t j;
+
+    TEST_CHECK(ljson_schema_compile(&test_crowd_schema, test_crowd_inst, countof(test_crowd_inst), test_crowd_top) == LJSON_ERROR_NONE);
+    item = ljson_schema_find(&test_crowd_schema, "point");
+    strcpy(test_crowd.name, "crowd");
+    for (i = 0; i < countof(test_crowd.point); i++)
+    {
+        test_crowd.point[i].x = (int32_t)i;
+        test_crowd.point[i].y = -(int32_t)(i * 7);
+    }
+    test_crowd.tail[0] = 1;
+    test_crowd.tail_count = 1;
+    TEST_CHECK(ljson_pool_init(&pool) == LJSON_ERROR_NONE);
+
+    for (i = 0; i < countof(count); i++)
+    {
+        test_crowd.point_count = count[i];
+        ljson_contex_init(&contex, &test_crowd_schema, &test_crowd);
+        ljson_writer_init(&writer, test_crowd_text, sizeof(test_crowd_text) - 1, 0, 0);
+        TEST_CHECK(ljson_contex_write(&contex, &writer, 0) == LJSON_ERROR_NONE);
+        test_crowd_text[writer.used] = '\0';
+        for (j = 0; j < countof(size); j++)
+        {
+            /* a part over its slice of a small slab is written again on the caller */
+            ljson_contex_init(&contex, &test_crowd_schema, &test_crowd);
+            ljson_writer_init(&writer, text, sizeof(text) - 1, 0, 0);
+            TEST_CHECK(ljson_contex_write_parallel(&contex, &writer, &pool, item, part, countof(part), slab, size[j]) == LJSON_ERROR_NONE);
+            text[writer.used] = '\0';
+            TEST_CHECK(strcmp(text, test_crowd_text) == 0);
+        }
+    }
+
+    ljson_pool_exit(&pool);
+}
+
+////////////////////////////////////////
+
+/* long strings kept in place by a writer with ljson_writer_iovec */
+typedef struct _test_note
+{
+    int32_t id;
+    char text[160];
+    char tag[8];
+} test_note_t;
+
+static const ljson_item_t test_note_items[] =
+{
+    { "id", LJSON_ITEM_INTEGER, sizeof(int32_t), LJSON_OFFSET(test_note_t, id) },
+    { "text", LJSON_ITEM_STRING, sizeof(((test_note_t *)0)->text), LJSON_OFFSET(test_note_t, text) },
+    { "tag", LJSON_ITEM_STRING, sizeof(((test_note_t *)0)->tag), LJSON_OFFSET(test_note_t, tag) },
+};
+
+static const ljson_item_t test_note_top[] =
+{
+    { 0, LJSON_ITEM_OBJECT, countof(test_note_items), (void *)test_note_items },
+};
+
+static const test_note_t *test_note_kept;
+static uint16_t test_note_refs;
+
+static uint8_t test_note_flushv(const ljson_iovec_t *iov, uint16_t count, void *user)
+{
+    uint16_t i;
+
+    (void)user;
+    for (i = 0; i < count; i++)
+    {
+        if (test_sink_used + iov[i].iov_len >= sizeof(test_sink))
+        {
+            return LJSON_ERROR_BUFFER_OVER;
+        }
+        if (((const char *)iov[i].iov_base >= test_note_kept->text) && ((const char *)iov[i].iov_base < test_note_kept->text + sizeof(test_note_kept->text)))
+        {
+            test_note_refs++;
+        }
+        memcpy(test_sink + test_sink_used, iov[i].iov_base, iov[i].iov_len);
+        test_sink_used += (uint32_t)iov[i].iov_len;
+    }
+    test_sink[test_sink_used] = '\0';
+    test_sink_calls++;
+
+    return LJSON_ERROR_NONE;
+}
+
+static void test_iovec(void)
+{
+    test_note_t note;
+    ljson_inst_t inst[8];
+    ljson_schema_t note_schema;
+    ljson_contex_t contex;
+    ljson_writer_t writer;
+    ljson_iovec_t iov[3];
+    char block[16];
+    char expect[256];
+    uint16_t length;
+
+    TEST_CHECK(ljson_schema_compile(&note_schema, inst, countof(inst), test_note_top) == LJSON_ERROR_NONE);
+    memset(&note, 0, sizeof(note));
+    note.id = 12;
+    memset(note.text, 'x', 150);
+    note.text[70] = '"';
+    strcpy(note.tag, "t");
+    ljson_contex_init(&contex, &note_schema, &note);
+    length = ljson_contex_snprintf(&contex, expect, sizeof(expect), 0);
+
+    test_sink_used = 0;
+    test_sink_calls = 0;
+    test_note_kept = &note;
+    test_note_refs = 0;
+    ljson_writer_init(&writer, block, sizeof(block), 0, 0);
+    ljson_writer_iovec(&writer, iov, countof(iov), test_note_flushv);
+    ljson_contex_init(&contex, &note_schema, &note);
+    TEST_CHECK(ljson_contex_write(&contex, &writer, 0) == LJSON_ERROR_NONE);
+    TEST_CHECK((writer.length == length) && (strcmp(test_sink, expect) == 0));
+    /* the runs either side of the escaped '"' */
+    TEST_CHECK(test_note_refs == 2);
+
+    /* short text is copied */
+    memset(note.text, 0, sizeof(note.text));
+    strcpy(note.text, "short");
+    test_sink_used = 0;
+    test_note_refs = 0;
+    ljson_writer_init(&writer, block, sizeof(block), 0, 0);
+    ljson_writer_iovec(&writer, iov, countof(iov), test_note_flushv);
+    ljson_contex_init(&contex, &note_schema, &note);
+    TEST_CHECK(ljson_contex_write(&contex, &writer, 0) == LJSON_ERROR_NONE);
+    TEST_CHECK((strcmp(test_sink, "{\"id\":12,\"text\":\"short\",\"tag\":\"t\"}") == 0) && (test_note_refs == 0));
+}
+
+////////////////////////////////////////
+
+/* ljson_cbor_write read back with ljson_cbor_feed, in pieces of every size */
+static uint8_t test_cbor_trip(const ljson_schema_t *schema, void *base, void *back, uint32_t size)
+{
+    static uint8_t cbor_text[1024];
+    static char expect[1024];
+    static char text[1024];
+    ljson_contex_t contex;
+    ljson_writer_t writer;
+    ljson_cbor_t cbor;
+    uint32_t piece;
+    uint32_t i;
+    uint32_t n;
+
+    ljson_contex_init(&contex, schema, base);
+    ljson_contex_snprintf(&contex, expect, sizeof(expect), 0);
+    ljson_contex_init(&contex, schema, base);
+    ljson_writer_init(&writer, cbor_text, sizeof(cbor_text), 0, 0);
+    if ((ljson_cbor_write(&contex, &writer) != LJSON_ERROR_NONE) || (writer.length > sizeof(cbor_text)))
+    {
+        return 0;
+    }
+    for (piece = 1; piece <= writer.used; piece++)
+    {
+        memset(back, 0, size);
+        ljson_contex_init(&contex, schema, back);
+        ljson_cbor_init(&cbor, ljson_callback_default, &contex);
+        for (i = 0; i < writer.used; i += n)
+        {
+            n = (writer.used - i < piece) ? (writer.used - i) : piece;
+            if (ljson_cbor_feed(&cbor, cbor_text + i, (uint16_t)n) != LJSON_ERROR_NONE)
+            {
+                return 0;
+            }
+        }
+        ljson_contex_init(&contex, schema, back);
+        ljson_contex_snprintf(&contex, text, sizeof(text), 0);
+        if ((cbor.level != 0) || (strcmp(text, expect) != 0))
+        {
+            printf("cbor in pieces of %u: %s\n", piece, text);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void test_cbor(void)
+{
+    static const uint8_t half[] = { 0xA2, 0x61, 'x', 0xF9, 0x40, 0x00, 0x61, 'y', 0x38, 0x63 };
+    static const uint8_t more[][5] =
+    {
+        { 0xA1, 0x61, 'x', 0x1F, 0x00 },    /* unsigned */
+        { 0xA1, 0x61, 'x', 0x3F, 0x00 },    /* negative */
+        { 0xA1, 0x61, 'x', 0xDF, 0x01 },    /* tag */
+        { 0xA1, 0x61, 'x', 0xFF, 0x00 },    /* break in a map of one */
+        { 0xFF, 0x00, 0x00, 0x00, 0x00 },   /* break at the top */
+    };
+    static const uint8_t indefinite[] = { 0xBF, 0x61, 'x', 0x01, 0x61, 'y', 0x20, 0xFF };
+    test_class_t klass;
+    test_class_t klass_back;
+    test_shape_t shape;
+    test_shape_t shape_back;
+    test_raw_t raw;
+    test_raw_t raw_back;
+    test_point_t point;
+    ljson_inst_t inst[16];
+    ljson_schema_t raw_schema;
+    ljson_schema_t point_schema;
+    ljson_contex_t contex;
+    ljson_cbor_t cbor;
+    static const ljson_item_t point_top[] =
+    {
+        { 0, LJSON_ITEM_OBJECT, countof(test_point_items), (void *)test_point_items },
+    };
+    ljson_inst_t point_inst[4];
+    uint16_t i;
+
+    memset(&klass, 0, sizeof(klass));
+    TEST_CHECK(test_class(&klass, 0, "{\"teacher\":{\"name\":\"c\",\"old\":200,\"height\":-1.5,\"width\":1e300,\"boy\":true},\"mark\":[0,65535]}") == LJSON_ERROR_NONE);
+    TEST_CHECK(test_cbor_trip(&test_class_schema, &klass, &klass_back, sizeof(klass_back)));
+    TEST_CHECK(memcmp(&klass, &klass_back, sizeof(klass)) == 0);
+
+    TEST_CHECK(test_shape(&shape, "{\"type\":\"point\",\"body\":{\"x\":-3,\"y\":4}}") == LJSON_ERROR_NONE);
+    TEST_CHECK(test_cbor_trip(&test_shape_schema, &shape, &shape_back, sizeof(shape_back)));
+
+    /* text items of arrays, as text strings */
+    TEST_CHECK(ljson_schema_compile(&raw_schema, inst, countof(inst), test_raw_top) == LJSON_ERROR_NONE);
+    memset(&raw, 0, sizeof(raw));
+    ljson_contex_init(&contex, &raw_schema, &raw);
+    TEST_CHECK(test_feed(&contex, "{\"value\":[1],\"text\":[\"s\",{\"a\":null},-2]}") == LJSON_ERROR_NONE);
+    TEST_CHECK(test_cbor_trip(&raw_schema, &raw, &raw_back, sizeof(raw_back)));
+    TEST_CHECK((raw_back.text_count == 3) && (strcmp(raw_back.text[1], "{\"a\":null}") == 0) && (strcmp(raw_back.value, "[1]") == 0));
+
+    /* a half float and a negative integer */
+    TEST_CHECK(ljson_schema_compile(&point_schema, point_inst, countof(point_inst), point_top) == LJSON_ERROR_NONE);
+    memset(&point, 0, sizeof(point));
+    ljson_contex_init(&contex, &point_schema, &point);
+    ljson_cbor_init(&cbor, ljson_callback_default, &contex);
+    TEST_CHECK(ljson_cbor_feed(&cbor, half, sizeof(half)) == LJSON_ERROR_NONE);
+    TEST_CHECK((point.x == 2) && (point.y == -100) && (cbor.level == 0));
+
+    /* 31 only for strings, arrays and maps, and as the 0xFF break of an indefinite one */
+    for (i = 0; i < countof(more); i++)
+    {
+        ljson_contex_init(&contex, &point_schema, &point);
+        ljson_cbor_init(&cbor, ljson_callback_default, &contex);
+        TEST_CHECK(ljson_cbor_feed(&cbor, more[i], sizeof(more[i])) == LJSON_ERROR_CBOR);
+    }
+    memset(&point, 0, sizeof(point));
+    ljson_contex_init(&contex, &point_schema, &point);
+    ljson_cbor_init(&cbor, ljson_callback_default, &contex);
+    TEST_CHECK(ljson_cbor_feed(&cbor, indefinite, sizeof(indefinite)) == LJSON_ERROR_NONE);
+    TEST_CHECK((point.x == 1) && (point.y == -1) && (cbor.level == 0));
+}
+
+////////////////////////////////////////
+
+/* compressed text into test_class_t through ljson_parser_flush */
+static const uint8_t test_zlib_raw[] =
+{
+    0xAB, 0x56, 0x2A, 0x49, 0x4D, 0x4C, 0xCE, 0x48, 0x2D, 0x52, 0xB2, 0xAA, 0x56, 0xCA, 0x4B, 0xCC, 0x4D, 0x55, 0xB2, 0x52,
+    0xAA, 0x82, 0x03, 0x25, 0x1D, 0xA5, 0xFC, 0x9C, 0x14, 0x25, 0x2B, 0xF3, 0x5A, 0x1D, 0xA5, 0xDC, 0xC4, 0xA2, 0x6C, 0x25,
+    0xAB, 0x68, 0x43, 0x43, 0x1D, 0x18, 0x8A, 0xAD, 0x05, 0x00,
+};
+
+static const uint8_t test_zlib_zlib[] =
+{
+    0x78, 0xDA, 0xAB, 0x56, 0x2A, 0x49, 0x4D, 0x4C, 0xCE, 0x48, 0x2D, 0x52, 0xB2, 0xAA, 0x56, 0xCA, 0x4B, 0xCC, 0x4D, 0x55,
+    0xB2, 0x52, 0xAA, 0x82, 0x03, 0x25, 0x1D, 0xA5, 0xFC, 0x9C, 0x14, 0x25, 0x2B, 0xF3, 0x5A, 0x1D, 0xA5, 0xDC, 0xC4, 0xA2,
+    0x6C, 0x25, 0xAB, 0x68, 0x43, 0x43, 0x1D, 0x18, 0x8A, 0xAD, 0x05, 0x00, 0x9C, 0x76, 0x13, 0xAB,
+};
+
+static const uint8_t test_zlib_gzip[] =
+{
+    0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xAB, 0x56, 0x2A, 0x49, 0x4D, 0x4C, 0xCE, 0x48, 0x2D, 0x52,
+    0xB2, 0xAA, 0x56, 0xCA, 0x4B, 0xCC, 0x4D, 0x55, 0xB2, 0x52, 0xAA, 0x82, 0x03, 0x25, 0x1D, 0xA5, 0xFC, 0x9C, 0x14, 0x25,
+    0x2B, 0xF3, 0x5A, 0x1D, 0xA5, 0xDC, 0xC4, 0xA2, 0x6C, 0x25, 0xAB, 0x68, 0x43, 0x43, 0x1D, 0x18, 0x8A, 0xAD, 0x05, 0x00,
+    0x79, 0x50, 0xFD, 0xF0, 0x3E, 0x00, 0x00, 0x00,
+};
+
+static uint8_t test_inflate(test_class_t *klass, uint8_t format, const uint8_t *buffer, uint32_t length, uint32_t piece)
+{
+    static ljson_inflate_t inflater;
+    ljson_parser_t parser;
+    ljson_contex_t contex;
+    uint32_t i;
+    uint8_t res = LJSON_ERROR_MORE;
+
+    memset(klass, 0, sizeof(test_class_t));
+    ljson_contex_init(&contex, &test_class_schema, klass);
+    ljson_parser_init(&parser, ljson_callback_default, &contex);
+    if (ljson_inflate_init(&inflater, format, ljson_parser_flush, &parser) != LJSON_ERROR_NONE)
+    {
+        return LJSON_ERROR_ZLIB;
+    }
+    for (i = 0; (i < length) && (res == LJSON_ERROR_MORE); i += piece)
+    {
+        res = ljson_inflate_feed(&inflater, buffer + i, (length - i < piece) ? (length - i) : piece);
+    }
+    ljson_inflate_exit(&inflater);
+
+    return res;
+}
+
+static void test_zlib(void)
+{
+    static const uint8_t format[] = { LJSON_ZLIB_RAW, LJSON_ZLIB_ZLIB, LJSON_ZLIB_GZIP };
+    static ljson_deflate_t deflater;
+    test_class_t klass;
+    test_class_t back;
+    ljson_contex_t contex;
+    ljson_writer_t writer;
+    uint8_t deflated[512];
+    uint32_t length;
+    char block[16];
+    uint32_t piece;
+    uint16_t i;
+
+    for (piece = 1; piece <= sizeof(test_zlib_gzip); piece += 7)
+    {
+        TEST_CHECK(test_inflate(&klass, LJSON_ZLIB_RAW, test_zlib_raw, sizeof(test_zlib_raw), piece) == LJSON_ERROR_NONE);
+        TEST_CHECK((strcmp(klass.teacher.name, "zzzzzzzzzz") == 0) && (klass.mark_count == 4) && (klass.mark[3] == 11));
+        TEST_CHECK(test_inflate(&klass, LJSON_ZLIB_ZLIB, test_zlib_zlib, sizeof(test_zlib_zlib), piece) == LJSON_ERROR_NONE);
+        TEST_CHECK((strcmp(klass.teacher.name, "zzzzzzzzzz") == 0) && (klass.mark_count == 4) && (klass.mark[3] == 11));
+        TEST_CHECK(test_inflate(&klass, LJSON_ZLIB_GZIP, test_zlib_gzip, sizeof(test_zlib_gzip), piece) == LJSON_ERROR_NONE);
+        TEST_CHECK((strcmp(klass.teacher.name, "zzzzzzzzzz") == 0) && (klass.mark_count == 4) && (klass.mark[3] == 11));
+        TEST_CHECK(test_inflate(&klass, LJSON_ZLIB_AUTO, test_zlib_zlib, sizeof(test_zlib_zlib), piece) == LJSON_ERROR_NONE);
+        TEST_CHECK(test_inflate(&klass, LJSON_ZLIB_AUTO, test_zlib_gzip, sizeof(test_zlib_gzip), piece) == LJSON_ERROR_NONE);
+    }
+    TEST_CHECK(test_inflate(&klass, LJSON_ZLIB_GZIP, test_zlib_zlib, sizeof(test_zlib_zlib), 1) == LJSON_ERROR_ZLIB);
+    memcpy(deflated, test_zlib_zlib, sizeof(test_zlib_zlib));
+    deflated[sizeof(test_zlib_zlib) - 1] ^= 1;
+    TEST_CHECK(test_inflate(&klass, LJSON_ZLIB_ZLIB, deflated, sizeof(test_zlib_zlib), 1) == LJSON_ERROR_ZLIB);
+
+    /* ljson_contex_write through ljson_deflate_flush, then back */
+    memset(&klass, 0, sizeof(klass));
+    TEST_CHECK(test_class(&klass, 0, "{\"teacher\":{\"name\":\"deflate\",\"old\":9,\"width\":2.5},\"mark\":[3,2,1]}") == LJSON_ERROR_NONE);
+    for (i = 0; i < countof(format); i++)
+    {
+        test_sink_used = 0;
+        TEST_CHECK(ljson_deflate_init(&deflater, format[i], 6, test_sink_flush, 0) == LJSON_ERROR_NONE);
+        ljson_writer_init(&writer, block, sizeof(block), ljson_deflate_flush, &deflater);
+        ljson_contex_init(&contex, &test_class_schema, &klass);
+        TEST_CHECK(ljson_contex_write(&contex, &writer, 1) == LJSON_ERROR_NONE);
+        TEST_CHECK(ljson_deflate_end(&deflater) == LJSON_ERROR_NONE);
+        length = (test_sink_used < sizeof(deflated)) ? test_sink_used : sizeof(deflated);
+        memcpy(deflated, test_sink, length);
+        TEST_CHECK(test_inflate(&back, format[i], deflated, length, 1) == LJSON_ERROR_NONE);
+        TEST_CHECK(memcmp(&back, &klass, sizeof(klass)) == 0);
+        if (format[i] != LJSON_ZLIB_RAW)
+        {
+            TEST_CHECK(test_inflate(&back, LJSON_ZLIB_AUTO, deflated, length, 3) == LJSON_ERROR_NONE);
+        }
+    }
+}
+
+////////////////////////////////////////
+
+/* test_crowd_t bound from text split over ljson_pool_t, the same as bound on one thread */
+static void test_parse_parallel(void)
+{
+    static test_crowd_t serial;
+    static test_crowd_t parallel;
+    static ljson_part_t part[4];
+    static uint32_t offset[64];
+    static const uint32_t count[] = { 1000, 0, 1, 63, 64, 300, 999 };
+    ljson_index_t index;
+    ljson_pool_t pool;
+    ljson_contex_t contex;
+    ljson_writer_t writer;
+    uint16_t item = ljson_schema_find(&test_crowd_schema, "point");
+    uint32_t i;
+
+    TEST_CHECK(ljson_pool_init(&pool) == LJSON_ERROR_NONE);
+    for (i = 0; i < countof(count); i++)
+    {
+        test_crowd.point_count = count[i];
+        ljson_contex_init(&contex, &test_crowd_schema, &test_crowd);
+        ljson_writer_init(&writer, test_crowd_text, sizeof(test_crowd_text) - 1, 0, 0);
+        TEST_CHECK(ljson_contex_write(&contex, &writer, 0) == LJSON_ERROR_NONE);
+        test_crowd_text[writer.used] = '\0';
+
+        memset(&serial, 0, sizeof(serial));
+        ljson_contex_init(&contex, &test_crowd_schema, &serial);
+        TEST_CHECK(test_feed(&contex, test_crowd_text) == LJSON_ERROR_NONE);
+        memset(&parallel, 0, sizeof(parallel));
+        ljson_contex_init(&contex, &test_crowd_schema, &parallel);
+        ljson_index_init(&index, offset, countof(offset));
+        TEST_CHECK(ljson_contex_parse_parallel(&contex, &pool, item, part, countof(part), &index, test_crowd_text, writer.used) == LJSON_ERROR_NONE);
+        TEST_CHECK((parallel.point_count == count[i]) && (memcmp(&parallel, &serial, sizeof(serial)) == 0));
+    }
+
+    /* a broken item in one of the parts */
+    test_crowd.point_count = 1000;
+    ljson_contex_init(&contex, &test_crowd_schema, &test_crowd);
+    ljson_writer_init(&writer, test_crowd_text, sizeof(test_crowd_text) - 1, 0, 0);
+    TEST_CHECK(ljson_contex_write(&contex, &writer, 0) == LJSON_ERROR_NONE);
+    test_crowd_text[writer.used] = '\0';
+    *strstr(test_crowd_text, "\"x\":700") = '{';
+    memset(&parallel, 0, sizeof(parallel));
+    ljson_contex_init(&contex, &test_crowd_schema, &parallel);
+    ljson_index_init(&index, offset, countof(offset));
+    TEST_CHECK(ljson_contex_parse_parallel(&contex, &pool, item, part, countof(part), &index, test_crowd_text, writer.used) != LJSON_ERROR_NONE);
+
+    ljson_pool_exit(&pool);
+}
+
+////////////////////////////////////////
+
+/* NDJSON of test_point_t over ljson_pool_t, every 97th line broken */
+#define TEST_LINES  10000
+
+static char test_lines[TEST_LINES * 32];
+static uint32_t test_line_at[TEST_LINES];
+static uint8_t test_line_seen[TEST_LINES];
+static int32_t test_line_last;
+static uint32_t test_line_got;
+static uint32_t test_line_skip;
+static uint32_t test_line_wrong;
+static uint32_t test_line_base;     /* of the block being parsed */
+static pthread_mutex_t test_line_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint8_t test_line_deliver(ljson_batch_t *batch, void *user)
+{
+    const test_point_t *point = (const test_point_t *)batch->record;
+    uint8_t order = (user != 0);
+    uint32_t i;
+
+    pthread_mutex_lock(&test_line_mutex);
+    for (i = 0; i < batch->count; i++)
+    {
+        if ((point[i].x < 0) || (point[i].x >= TEST_LINES) || (point[i].y != -point[i].x) || test_line_seen[point[i].x]
+            || (order && (point[i].x <= test_line_last)))
+        {
+            test_line_wrong++;
+            continue;
+        }
+        test_line_seen[point[i].x] = 1;
+        test_line_last = point[i].x;
+    }
+    test_line_got += batch->count;
+    pthread_mutex_unlock(&test_line_mutex);
+
+    return LJSON_ERROR_NONE;
+}
+
+static void test_line_skipped(void *user, uint32_t offset, uint8_t res)
+{
+    uint32_t i = 0;
+
+    (void)user;
+    pthread_mutex_lock(&test_line_mutex);
+    offset += test_line_base;
+    /* the offset is the start of a broken line */
+    while ((i < TEST_LINES) && (test_line_at[i] < offset))
+    {
+        i++;
+    }
+    if ((i >= TEST_LINES) || (test_line_at[i] != offset) || (i % 97 != 0) || (res == LJSON_ERROR_NONE))
+    {
+        test_line_wrong++;
+    }
+    test_line_skip++;
+    pthread_mutex_unlock(&test_line_mutex);
+}
+
+static void test_ndjson(void)
+{
+    static ljson_batch_t batch[3];
+    static test_point_t record[3][50];
+    static const uint8_t flag[] = { 0, LJSON_NDJSON_ORDER };
+    ljson_inst_t inst[8];
+    ljson_schema_t point_schema;
+    ljson_pool_t pool;
+    ljson_ndjson_t ndjson;
+    uint32_t length = 0;
+    uint32_t offset;
+    uint32_t piece;
+    uint32_t i;
+    uint16_t j;
+    uint8_t res = LJSON_ERROR_NONE;
+    static const ljson_item_t point_top[] =
+    {
+        { 0, LJSON_ITEM_OBJECT, countof(test_point_items), (void *)test_point_items },
+    };
+
+    for (i = 0; i < TEST_LINES; i++)
+    {
+        test_line_at[i] = length;
+        length += sprintf(test_lines + length, (i % 97 == 0) ? "{\"x\":%d,\"y\":%d\n" : "{\"x\":%d,\"y\":%d}\n", (int)i, -(int)i);
+    }
+    /* the last line without its '\n' */
+    length--;
+    TEST_CHECK(ljson_schema_compile(&point_schema, inst, countof(inst), point_top) == LJSON_ERROR_NONE);
+    TEST_CHECK(ljson_pool_init(&pool) == LJSON_ERROR_NONE);
+
+    for (j = 0; j < countof(flag); j++)
+    {
+        memset(test_line_seen, 0, sizeof(test_line_seen));
+        test_line_last = -1;
+        test_line_got = 0;
+        test_line_skip = 0;
+        test_line_wrong = 0;
+        for (i = 0; i < countof(batch); i++)
+        {
+            ljson_batch_init(&batch[i], &point_schema, record[i], sizeof(test_point_t), countof(record[i]));
+        }
+        ljson_ndjson_init(&ndjson, &pool, batch, countof(batch), flag[j], test_line_deliver, test_line_skipped,
+            (flag[j] & LJSON_NDJSON_ORDER) ? (void *)&ndjson : 0);
+        /* in blocks that cut lines, the tail of each given again */
+        for (offset = 0; offset < length; offset += ndjson.used)
+        {
+            piece = (length - offset > 100000) ? 100000 : (length - offset);
+            test_line_base = offset;
+            res = ljson_ndjson_parse(&ndjson, test_lines + offset, piece, (offset + piece == length) ? LJSON_NDJSON_END : 0);
+            if (res != LJSON_ERROR_NONE)
+            {
+                break;
+            }
+        }
+        ljson_ndjson_exit(&ndjson);
+        TEST_CHECK(res == LJSON_ERROR_NONE);
+        TEST_CHECK((test_line_got == TEST_LINES - (TEST_LINES + 96) / 97) && (test_line_skip == (TEST_LINES + 96) / 97) && (test_line_wrong == 0));
+    }
+
+    ljson_pool_exit(&pool);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 const char str_json[] =
     "{\"name\":\"abc\",\"number\":123,\"student\":[{\"name\":\"no1\",\"old\":111,\"height\":163.2,\"width\":23.6,\"boy\":true},"
     "{\"name\":\"no2\",\"old\":22,\"height\":163.2,\"width\":23.6,\"boy\":true},{\"name\":\"no3\",\"old\":123,\"height\":163.2,"
@@ -114,18 +1968,47 @@ int main(int argc, char* argv[])
     ljson_parser_t parser;
     ljson_contex_t contex;
 
-    ljson_contex_init(&contex, ljson_top);
+    uint8_t res = ljson_schema_compile(&schema, schema_buffer, countof(schema_buffer), ljson_top);
+    printf("ljson_schema_compile:0x%02X %d\n", res, schema.count);
+
+    ljson_contex_init(&contex, &schema, &school);
     ljson_parser_init(&parser, ljson_callback_default, &contex);
 
-    uint8_t res = ljson_parser_feed(&parser, str_json, sizeof(str_json) - 1);
+    res = ljson_parser_feed(&parser, str_json, sizeof(str_json) - 1);
     printf("ljson_parser_feed:0x%02X\n", res);
 
     char buffer[6395];
-    ljson_contex_init(&contex, ljson_top);
+    ljson_contex_init(&contex, &schema, &school);
     int len = ljson_contex_snprintf(&contex, buffer, sizeof(buffer), 1);
     printf("ljson_contex_snprintf:%d\n", len);
     printf("%s\n", buffer);
 
-    return 0;
+    test_offset();
+    test_stream();
+    test_union();
+    test_vector();
+    test_want();
+    test_raw();
+    test_patch();
+    test_dict();
+    test_fingerprint();
+    test_writer();
+    test_escape();
+    test_producer();
+    test_real();
+    test_serializer();
+    test_numbers();
+    test_project();
+    test_diff();
+    test_touch();
+    test_iovec();
+    test_cbor();
+    test_zlib();
+    test_parallel();
+    test_parse_parallel();
+    test_ndjson();
+
+    printf("ljson_test:%d failed\n", test_fail);
+    return (test_fail == 0) ? 0 : 1;
 }
 
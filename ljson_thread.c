@@ -0,0 +1,767 @@
+#include "ljson_thread.h"
+#include <string.h> /* memset memchr */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h> /* _mm_xxx */
+#define LJSON_SSE2
+#endif
+
+#define LJSON_ERROR_SPLIT       0x80    /* from _ljson_split_callback, the feed stopped after the '[' of the array to split */
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* jobs left of the run, mutex held */
+static void _ljson_pool_work(ljson_pool_t *pool)
+{
+    uint16_t index;
+
+    while (pool->job_next < pool->job_count)
+    {
+        index = pool->job_next++;
+        pthread_mutex_unlock(&pool->mutex);
+        pool->job(pool->user, index);
+        pthread_mutex_lock(&pool->mutex);
+        if (++pool->job_done == pool->job_count)
+        {
+            pthread_cond_broadcast(&pool->done);
+        }
+    }
+}
+
+static void *_ljson_pool_main(void *arg)
+{
+    ljson_pool_t *pool = (ljson_pool_t *)arg;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (!pool->stop)
+    {
+        _ljson_pool_work(pool);
+        if (!pool->stop)
+        {
+            pthread_cond_wait(&pool->work, &pool->mutex);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return 0;
+}
+
+uint8_t ljson_pool_init(ljson_pool_t *pool)
+{
+    uint8_t i;
+
+    memset(pool, 0, sizeof(ljson_pool_t));
+    pthread_mutex_init(&pool->mutex, 0);
+    pthread_cond_init(&pool->work, 0);
+    pthread_cond_init(&pool->done, 0);
+    for (i = 0; i < LJSON_THREAD_COUNT; i++)
+    {
+        if (pthread_create(&pool->thread[i], 0, _ljson_pool_main, pool) != 0)
+        {
+            ljson_pool_exit(pool);
+            return LJSON_ERROR_THREAD;
+        }
+        pool->count++;
+    }
+
+    return LJSON_ERROR_NONE;
+}
+
+void ljson_pool_exit(ljson_pool_t *pool)
+{
+    uint8_t i;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->mutex);
+    for (i = 0; i < pool->count; i++)
+    {
+        pthread_join(pool->thread[i], 0);
+    }
+    pool->count = 0;
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->mutex);
+}
+
+/* job(user, 0) to job(user, count - 1) on the workers and the caller, back when all are done */
+void ljson_pool_run(ljson_pool_t *pool, ljson_job_t job, void *user, uint16_t count)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->job = job;
+    pool->user = user;
+    pool->job_count = count;
+    pool->job_next = 0;
+    pool->job_done = 0;
+    pthread_cond_broadcast(&pool->work);
+
+    _ljson_pool_work(pool);
+    while (pool->job_done < pool->job_count)
+    {
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* the block is kept where it is, the next one follows it in the slice */
+static uint8_t _ljson_part_flush(const void *buffer, uint16_t length, void *user)
+{
+    ljson_part_t *part = (ljson_part_t *)user;
+    uint32_t room;
+
+    (void)buffer;
+    part->used += length;
+    room = part->size - part->used;
+    if (room == 0)
+    {
+        return LJSON_ERROR_BUFFER_OVER;
+    }
+    part->writer.buffer = part->buffer + part->used;
+    part->writer.size = (room > 0xFFFF) ? 0xFFFF : (uint16_t)room;
+
+    return LJSON_ERROR_NONE;
+}
+
+static void _ljson_part_write(void *user, uint16_t index)
+{
+    ljson_part_t *part = &((ljson_part_t *)user)[index];
+
+    ljson_writer_init(&part->writer, part->buffer, (part->size > 0xFFFF) ? 0xFFFF : (uint16_t)part->size, _ljson_part_flush, part);
+    part->used = 0;
+    part->res = ljson_contex_seek(&part->contex, part->index);
+    if (part->res == LJSON_ERROR_NONE)
+    {
+        part->res = ljson_contex_write_part(&part->contex, &part->writer, LJSON_INST_NONE, part->count);
+    }
+    part->used += part->writer.used;
+}
+
+/* as ljson_contex_write without fmt, the items of the array item (ljson_schema_find) split into up to count parts,
+   each written on pool into its slice of buffer and then to writer in order, again on the caller if over its slice */
+uint8_t ljson_contex_write_parallel(ljson_contex_t *contex, ljson_writer_t *writer, ljson_pool_t *pool, uint16_t item,
+    ljson_part_t *part, uint16_t count, char *buffer, uint32_t size)
+{
+    ljson_contex_t walk;
+    uint32_t items;
+    uint32_t slice;
+    uint16_t used;
+    uint16_t i;
+    uint8_t res;
+
+    while (1)
+    {
+        res = ljson_contex_write_part(contex, writer, item, 0);
+        if (res != LJSON_ERROR_MORE)
+        {
+            break;
+        }
+
+        items = ljson_contex_count(contex);
+        used = (items / LJSON_PART_ITEMS < count) ? (uint16_t)(items / LJSON_PART_ITEMS) : count;
+        if (used < 2)
+        {
+            /* too few to share */
+            res = (items > 0) ? ljson_contex_write_part(contex, writer, LJSON_INST_NONE, items) : LJSON_ERROR_NONE;
+            if (res != LJSON_ERROR_NONE)
+            {
+                return res;
+            }
+            continue;
+        }
+
+        slice = size / used;
+        for (i = 0; i < used; i++)
+        {
+            part[i].contex = *contex;
+            part[i].index = (uint32_t)((uint64_t)items * i / used);
+            part[i].count = (uint32_t)((uint64_t)items * (i + 1) / used) - part[i].index;
+            part[i].buffer = buffer + slice * i;
+            part[i].size = slice;
+        }
+        ljson_pool_run(pool, _ljson_part_write, part, used);
+
+        for (i = 0; i < used; i++)
+        {
+            if ((part[i].res != LJSON_ERROR_NONE) && (part[i].writer.error == LJSON_ERROR_NONE))
+            {
+                return part[i].res;
+            }
+            if (i > 0)
+            {
+                ljson_writer_write(writer, ",", 1);
+            }
+            if (part[i].res == LJSON_ERROR_NONE)
+            {
+                ljson_writer_reference(writer, part[i].buffer, part[i].used);
+                continue;
+            }
+            walk = *contex;
+            ljson_contex_seek(&walk, part[i].index);
+            res = ljson_contex_write_part(&walk, writer, LJSON_INST_NONE, part[i].count);
+            if (res != LJSON_ERROR_NONE)
+            {
+                return res;
+            }
+        }
+        if (writer->iov != 0)
+        {
+            /* buffer is written again by the next parts */
+            ljson_writer_flush(writer);
+        }
+        /* on to the ']' */
+        ljson_contex_seek(contex, items);
+    }
+    if (res != LJSON_ERROR_NONE)
+    {
+        return res;
+    }
+
+    return ljson_writer_flush(writer);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* to the next '"' or '\\' of a string */
+static const char *_ljson_index_string(const char *cp, const char *eob)
+{
+#if defined(LJSON_SSE2)
+    __m128i v16;
+
+    while (eob - cp >= 16)
+    {
+        v16 = _mm_loadu_si128((const __m128i *)cp);
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v16, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v16, _mm_set1_epi8('\\')))) != 0)
+        {
+            break;
+        }
+        cp += 16;
+    }
+#endif
+    while ((cp < eob) && (*cp != '"') && (*cp != '\\'))
+    {
+        cp++;
+    }
+
+    return cp;
+}
+
+/* to the next '"', '{', '}', '[', ']' or ',' out of strings */
+static const char *_ljson_index_value(const char *cp, const char *eob)
+{
+#if defined(LJSON_SSE2)
+    __m128i v16;
+    __m128i fold;
+
+    while (eob - cp >= 16)
+    {
+        v16 = _mm_loadu_si128((const __m128i *)cp);
+        /* '[' ']' | 0x20 are '{' '}' */
+        fold = _mm_or_si128(v16, _mm_set1_epi8(0x20));
+        if (_mm_movemask_epi8(_mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v16, _mm_set1_epi8('"')), _mm_cmpeq_epi8(v16, _mm_set1_epi8(','))),
+            _mm_or_si128(_mm_cmpeq_epi8(fold, _mm_set1_epi8('{')), _mm_cmpeq_epi8(fold, _mm_set1_epi8('}'))))) != 0)
+        {
+            break;
+        }
+        cp += 16;
+    }
+#endif
+    while ((cp < eob) && (*cp != '"') && (*cp != ',') && ((*cp | 0x20) != '{') && ((*cp | 0x20) != '}'))
+    {
+        cp++;
+    }
+
+    return cp;
+}
+
+/* size offsets, 2 at least */
+void ljson_index_init(ljson_index_t *index, uint32_t *offset, uint32_t size)
+{
+    memset(index, 0, sizeof(ljson_index_t));
+    index->offset = offset;
+    index->size = size;
+}
+
+/* buffer from the '[' of an array on scanned for its ']' and the ',' between its items, strings and nested values skipped;
+   offsets are thinned out to every other one each time they fill, LJSON_ERROR_MORE if the ']' is not in buffer */
+uint8_t ljson_index_array(ljson_index_t *index, const void *buffer, uint32_t length)
+{
+    const char *start = (const char *)buffer;
+    const char *eob = start + length;
+    const char *cp = start + 1;
+    uint32_t depth = 1;
+    uint32_t i;
+
+    index->count = 0;
+    index->stride = 1;
+    index->items = 0;
+    index->end = 0;
+    if ((length == 0) || (*start != '['))
+    {
+        return LJSON_ERROR_ARRAY_L;
+    }
+    if (index->size < 2)
+    {
+        return LJSON_ERROR_BUFFER_OVER;
+    }
+    index->offset[index->count++] = 0;
+
+    while (1)
+    {
+        cp = _ljson_index_value(cp, eob);
+        if (cp >= eob)
+        {
+            return LJSON_ERROR_MORE;
+        }
+        if (*cp == '"')
+        {
+            for (cp++; ; cp += 2)
+            {
+                cp = _ljson_index_string(cp, eob);
+                if ((cp >= eob) || ((*cp == '\\') && (eob - cp < 2)))
+                {
+                    return LJSON_ERROR_MORE;
+                }
+                if (*cp == '"')
+                {
+                    break;
+                }
+                /* the escaped byte is skipped with the '\\' */
+            }
+        }
+        else if (*cp == ',')
+        {
+            if ((depth == 1) && (++index->items % index->stride == 0))
+            {
+                if (index->count == index->size)
+                {
+                    for (i = 0; i * 2 < index->count; i++)
+                    {
+                        index->offset[i] = index->offset[i * 2];
+                    }
+                    index->count = i;
+                    index->stride *= 2;
+                }
+                if (index->items % index->stride == 0)
+                {
+                    index->offset[index->count++] = (uint32_t)(cp - start);
+                }
+            }
+        }
+        else if ((*cp | 0x20) == '{')
+        {
+            depth++;
+        }
+        else if (--depth == 0)
+        {
+            break;
+        }
+        cp++;
+    }
+    index->end = (uint32_t)(cp - start);
+
+    /* items counted so far are the ',', one more unless empty */
+    for (cp = start + 1; (index->items == 0) && (cp < start + index->end) && ((uint8_t)(*cp) <= 0x20); cp++)
+    {
+    }
+    if ((index->items > 0) || (cp < start + index->end))
+    {
+        index->items++;
+    }
+
+    return LJSON_ERROR_NONE;
+}
+
+typedef struct _ljson_split
+{
+    ljson_contex_t *contex;
+    uint16_t item;
+} ljson_split_t;
+
+/* ljson_callback_default, stopping at the '[' of item */
+static uint8_t _ljson_split_callback(uint8_t type, uint8_t *buffer, uint16_t length, void *user)
+{
+    ljson_split_t *split = (ljson_split_t *)user;
+
+    if ((type == LJSON_TYPE_ARRAY_L) && (split->contex->ljson_item == split->item) && (split->contex->ljson_item_miss == 0))
+    {
+        return LJSON_ERROR_SPLIT;
+    }
+
+    return ljson_callback_default(type, buffer, length, split->contex);
+}
+
+static uint8_t _ljson_split_none(uint8_t type, uint8_t *buffer, uint16_t length, void *user)
+{
+    (void)type;
+    (void)buffer;
+    (void)length;
+    (void)user;
+    return LJSON_ERROR_NONE;
+}
+
+/* the '[' at cp on parser alone, its contex has the array pushed already */
+static uint8_t _ljson_split_open(ljson_parser_t *parser, const char *cp)
+{
+    ljson_callback_t callback = parser->callback;
+    uint8_t res;
+
+    parser->callback = _ljson_split_none;
+    res = ljson_parser_feed(parser, cp, 1);
+    parser->callback = callback;
+
+    return res;
+}
+
+static void _ljson_part_parse(void *user, uint16_t index)
+{
+    ljson_part_t *part = &((ljson_part_t *)user)[index];
+    const char *cp = part->text;
+    uint32_t left = part->length;
+    uint16_t piece;
+    uint8_t res = LJSON_ERROR_MORE;
+
+    part->res = LJSON_ERROR_NONE;
+    if (part->count == 0)
+    {
+        return;
+    }
+    ljson_parser_init(&part->parser, ljson_callback_default, &part->contex);
+    _ljson_split_open(&part->parser, "[");
+    ljson_contex_seek(&part->contex, part->index);
+    while ((res == LJSON_ERROR_MORE) && (left > 0))
+    {
+        piece = (left > 0xFFFF) ? 0xFFFF : (uint16_t)left;
+        res = ljson_parser_feed(&part->parser, cp, piece);
+        cp += piece;
+        left -= piece;
+    }
+    if (res == LJSON_ERROR_MORE)
+    {
+        /* the last item ends here, its own ',' or ']' is for the caller */
+        res = ljson_parser_feed(&part->parser, ",", 1);
+    }
+    /* the array is open till the end */
+    part->res = (res == LJSON_ERROR_MORE) ? LJSON_ERROR_NONE : (res == LJSON_ERROR_NONE) ? LJSON_ERROR_ARRAY_R : res;
+}
+
+/* as ljson_parser_feed with ljson_callback_default on contex over a whole document in buffer, the items of each
+   array item (ljson_schema_find, a LJSON_ITEM_ARRAY) met found by ljson_index_array first and then bound in up to
+   count parts on pool, each from its own ljson_contex_seek; the parts track nothing and have no arena */
+uint8_t ljson_contex_parse_parallel(ljson_contex_t *contex, ljson_pool_t *pool, uint16_t item, ljson_part_t *part, uint16_t count,
+    ljson_index_t *index, const void *buffer, uint32_t length)
+{
+    const char *text = (const char *)buffer;
+    ljson_parser_t parser;
+    ljson_split_t split;
+    uint32_t pos = 0;
+    uint32_t start;
+    uint32_t first;
+    uint32_t last;
+    uint16_t piece;
+    uint16_t used;
+    uint16_t i;
+    uint8_t res = LJSON_ERROR_MORE;
+
+    if ((item >= contex->schema->count) || (contex->schema->inst[item].type != LJSON_ITEM_ARRAY))
+    {
+        return LJSON_ERROR_ARRAY_L;
+    }
+    split.contex = contex;
+    split.item = item;
+    if (contex->schema->inst[contex->schema->inst[item].child].type == LJSON_ITEM_RAW)
+    {
+        /* items as text take the parser along, no split */
+        split.item = LJSON_INST_NONE;
+    }
+    ljson_parser_init(&parser, _ljson_split_callback, &split);
+
+    while (pos < length)
+    {
+        piece = (length - pos > 0xFFFF) ? 0xFFFF : (uint16_t)(length - pos);
+        res = ljson_parser_feed(&parser, text + pos, piece);
+        if (res != LJSON_ERROR_SPLIT)
+        {
+            if ((res != LJSON_ERROR_NONE) && (res != LJSON_ERROR_MORE))
+            {
+                return res;
+            }
+            pos += piece;
+            continue;
+        }
+
+        /* the '[' again, on contex this time */
+        start = pos + parser.used - 1;
+        res = ljson_callback_default(LJSON_TYPE_ARRAY_L, 0, 0, contex);
+        if (res != LJSON_ERROR_NONE)
+        {
+            return res;
+        }
+        _ljson_split_open(&parser, text + start);
+        pos = start + 1;
+
+        res = ljson_index_array(index, text + start, length - start);
+        if (res != LJSON_ERROR_NONE)
+        {
+            return res;
+        }
+        used = (index->items / LJSON_PART_ITEMS < count) ? (uint16_t)(index->items / LJSON_PART_ITEMS) : count;
+        if (used < 2)
+        {
+            /* too few to share, on as usual */
+            continue;
+        }
+
+        for (i = 0; i < used; i++)
+        {
+            first = (uint32_t)((uint64_t)index->items * i / used) / index->stride;
+            last = (uint32_t)((uint64_t)index->items * (i + 1) / used) / index->stride;
+            part[i].contex = *contex;
+            part[i].contex.mask = 0;
+            part[i].contex.want = 0;
+            part[i].contex.print = 0;
+            part[i].contex.change = 0;
+            part[i].contex.arena = 0;
+            part[i].index = first * index->stride;
+            part[i].text = text + start + index->offset[first] + 1;
+            if (i + 1 < used)
+            {
+                part[i].count = last * index->stride - part[i].index;
+                part[i].length = index->offset[last] - index->offset[first] - 1;
+            }
+            else
+            {
+                part[i].count = index->items - part[i].index;
+                part[i].length = index->end - index->offset[first] - 1;
+            }
+        }
+        ljson_pool_run(pool, _ljson_part_parse, part, used);
+
+        for (i = 0; i < used; i++)
+        {
+            if (part[i].res != LJSON_ERROR_NONE)
+            {
+                return part[i].res;
+            }
+        }
+        /* on to the ']' */
+        ljson_contex_seek(contex, index->items);
+        pos = start + index->end;
+    }
+
+    return res;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* schema relative to base (LJSON_OFFSET), room records of size bytes in record */
+void ljson_batch_init(ljson_batch_t *batch, const ljson_schema_t *schema, void *record, uint32_t size, uint32_t room)
+{
+    memset(batch, 0, sizeof(ljson_batch_t));
+    ljson_contex_init(&batch->contex, schema, record);
+    batch->record = (uint8_t *)record;
+    batch->size = size;
+    batch->room = room;
+}
+
+/* count batches, one per job of ljson_ndjson_parse on pool, best one more than LJSON_THREAD_COUNT */
+void ljson_ndjson_init(ljson_ndjson_t *ndjson, ljson_pool_t *pool, ljson_batch_t *batch, uint16_t count, uint8_t flag,
+    ljson_deliver_t deliver, ljson_skip_t skip, void *user)
+{
+    memset(ndjson, 0, sizeof(ljson_ndjson_t));
+    ndjson->pool = pool;
+    ndjson->batch = batch;
+    ndjson->count = count;
+    ndjson->flag = flag;
+    ndjson->deliver = deliver;
+    ndjson->skip = skip;
+    ndjson->user = user;
+    pthread_mutex_init(&ndjson->mutex, 0);
+    pthread_cond_init(&ndjson->turn, 0);
+}
+
+void ljson_ndjson_exit(ljson_ndjson_t *ndjson)
+{
+    pthread_cond_destroy(&ndjson->turn);
+    pthread_mutex_destroy(&ndjson->mutex);
+}
+
+/* one line into the next slot of batch, LJSON_ERROR_NONE if bound */
+static uint8_t _ljson_ndjson_line(ljson_batch_t *batch, const char *line, uint32_t length)
+{
+    uint8_t *record = batch->record + (size_t)batch->size * batch->count;
+    uint16_t piece;
+    uint8_t res = LJSON_ERROR_NONE;
+
+    memset(record, 0, batch->size);
+    batch->bind = batch->contex;
+    batch->bind.base = record;
+    if (batch->bind.mask != 0)
+    {
+        ljson_contex_track(&batch->bind, batch->bind.mask, batch->bind.want);
+    }
+    ljson_parser_init(&batch->parser, ljson_callback_default, &batch->bind);
+    while (length > 0)
+    {
+        piece = (length > 0xFFFF) ? 0xFFFF : (uint16_t)length;
+        res = ljson_parser_feed(&batch->parser, line, piece);
+        if ((res != LJSON_ERROR_MORE) && (res != LJSON_ERROR_NONE))
+        {
+            break;
+        }
+        line += piece;
+        length -= piece;
+    }
+
+    return (res == LJSON_ERROR_DONE) ? LJSON_ERROR_NONE : res;
+}
+
+/* records of batch out, after those of every earlier chunk with LJSON_NDJSON_ORDER, dropped once the run stops */
+static void _ljson_ndjson_deliver(ljson_ndjson_t *ndjson, ljson_batch_t *batch, uint32_t chunk)
+{
+    uint8_t stop;
+
+    pthread_mutex_lock(&ndjson->mutex);
+    while ((ndjson->flag & LJSON_NDJSON_ORDER) && (ndjson->chunk_turn != chunk))
+    {
+        pthread_cond_wait(&ndjson->turn, &ndjson->mutex);
+    }
+    stop = ndjson->stop;
+    pthread_mutex_unlock(&ndjson->mutex);
+
+    if ((batch->count > 0) && (batch->res == LJSON_ERROR_NONE) && !stop)
+    {
+        batch->res = ndjson->deliver(batch, ndjson->user);
+    }
+    batch->count = 0;
+    if (batch->res != LJSON_ERROR_NONE)
+    {
+        pthread_mutex_lock(&ndjson->mutex);
+        ndjson->stop = 1;
+        pthread_mutex_unlock(&ndjson->mutex);
+    }
+}
+
+/* chunks of lines into batch index until none are left */
+static void _ljson_ndjson_job(void *user, uint16_t index)
+{
+    ljson_ndjson_t *ndjson = (ljson_ndjson_t *)user;
+    ljson_batch_t *batch = &ndjson->batch[index];
+    const char *cp;
+    const char *eol;
+    const char *end;
+    const char *ch;
+    uint32_t chunk;
+    uint32_t last;
+    uint8_t res;
+
+    batch->count = 0;
+    batch->skip = 0;
+    batch->res = (batch->room > 0) ? LJSON_ERROR_NONE : LJSON_ERROR_BUFFER_OVER;
+    while (batch->res == LJSON_ERROR_NONE)
+    {
+        pthread_mutex_lock(&ndjson->mutex);
+        if (ndjson->stop || (ndjson->next >= ndjson->length))
+        {
+            pthread_mutex_unlock(&ndjson->mutex);
+            break;
+        }
+        /* up to the end of the line LJSON_NDJSON_CHUNK bytes on is in */
+        cp = ndjson->buffer + ndjson->next;
+        last = (ndjson->length - ndjson->next > LJSON_NDJSON_CHUNK) ? ndjson->next + LJSON_NDJSON_CHUNK : ndjson->length;
+        eol = (const char *)memchr(ndjson->buffer + last - 1, '\n', ndjson->length - last + 1);
+        end = (eol != 0) ? eol + 1 : ndjson->buffer + ndjson->length;
+        ndjson->next = (uint32_t)(end - ndjson->buffer);
+        chunk = ndjson->chunk_next++;
+        pthread_mutex_unlock(&ndjson->mutex);
+
+        for (; (cp < end) && (batch->res == LJSON_ERROR_NONE); cp = (eol < end) ? eol + 1 : end)
+        {
+            eol = (const char *)memchr(cp, '\n', end - cp);
+            if (eol == 0)
+            {
+                eol = end;
+            }
+            for (ch = cp; (ch < eol) && (((uint8_t)(*ch) <= 0x20) || ((uint8_t)(*ch) == 0x7F)); ch++)
+            {
+            }
+            if (ch == eol)
+            {
+                /* blank */
+                continue;
+            }
+            if (batch->count == batch->room)
+            {
+                _ljson_ndjson_deliver(ndjson, batch, chunk);
+                if (batch->res != LJSON_ERROR_NONE)
+                {
+                    break;
+                }
+            }
+
+            res = _ljson_ndjson_line(batch, cp, (uint32_t)(eol - cp));
+            if (res == LJSON_ERROR_NONE)
+            {
+                batch->count++;
+                continue;
+            }
+            batch->skip++;
+            if (ndjson->skip != 0)
+            {
+                ndjson->skip(ndjson->user, (uint32_t)(cp - ndjson->buffer), res);
+            }
+        }
+
+        if (ndjson->flag & LJSON_NDJSON_ORDER)
+        {
+            /* every chunk takes its turn, or the later ones would wait for ever */
+            _ljson_ndjson_deliver(ndjson, batch, chunk);
+            pthread_mutex_lock(&ndjson->mutex);
+            ndjson->chunk_turn++;
+            pthread_cond_broadcast(&ndjson->turn);
+            pthread_mutex_unlock(&ndjson->mutex);
+        }
+    }
+    if (!(ndjson->flag & LJSON_NDJSON_ORDER))
+    {
+        _ljson_ndjson_deliver(ndjson, batch, 0);
+    }
+}
+
+/* bind each line of buffer into a record of a batch on pool, a bad line skipped, every record delivered before the return;
+   the tail after the last '\n' is left (ljson_ndjson_t.used) for the next call unless flag has LJSON_NDJSON_END */
+uint8_t ljson_ndjson_parse(ljson_ndjson_t *ndjson, const void *buffer, uint32_t length, uint8_t flag)
+{
+    const char *cp = (const char *)buffer;
+    uint16_t i;
+
+    if (!(flag & LJSON_NDJSON_END))
+    {
+        while ((length > 0) && (cp[length - 1] != '\n'))
+        {
+            length--;
+        }
+    }
+    ndjson->buffer = cp;
+    ndjson->length = length;
+    ndjson->next = 0;
+    ndjson->chunk_next = 0;
+    ndjson->chunk_turn = 0;
+    ndjson->stop = 0;
+    ndjson->used = length;
+    ljson_pool_run(ndjson->pool, _ljson_ndjson_job, ndjson, ndjson->count);
+
+    for (i = 0; i < ndjson->count; i++)
+    {
+        if (ndjson->batch[i].res != LJSON_ERROR_NONE)
+        {
+            return ndjson->batch[i].res;
+        }
+    }
+
+    return LJSON_ERROR_NONE;
+}
@@ -0,0 +1,145 @@
+#ifndef _LJSON_THREAD_H_
+#define _LJSON_THREAD_H_
+
+#include <pthread.h>
+#include "ljson.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LJSON_THREAD_COUNT      4       /* workers of ljson_pool_t, the caller works too */
+#define LJSON_PART_ITEMS        64      /* fewest items for a part of an array of its own */
+#define LJSON_NDJSON_CHUNK      65536   /* bytes of lines taken at once by a job of ljson_ndjson_parse */
+
+#define LJSON_NDJSON_ORDER      0x01    /* ljson_ndjson_t.flag, batches delivered in the order of their lines */
+#define LJSON_NDJSON_END        0x02    /* ljson_ndjson_parse, the last line needs no '\n' */
+
+////////////////////////////////////////
+
+/* job index of a ljson_pool_run, on any thread */
+typedef void(*ljson_job_t)(void *user, uint16_t index);
+
+typedef struct _ljson_pool
+{
+    pthread_t thread[LJSON_THREAD_COUNT];
+    uint8_t count;          /* threads started */
+    uint8_t stop;
+    pthread_mutex_t mutex;
+    pthread_cond_t work;    /* jobs or stop */
+    pthread_cond_t done;    /* every job run */
+
+    /* ljson_pool_run */
+    ljson_job_t job;
+    void *user;
+    uint16_t job_count;
+    uint16_t job_next;
+    uint16_t job_done;
+} ljson_pool_t;
+
+/* items of an array written or bound by one job */
+typedef struct _ljson_part
+{
+    ljson_contex_t contex;
+    ljson_writer_t writer;  /* blocks one after another in buffer */
+    char *buffer;           /* slice of the buffer of ljson_contex_write_parallel */
+    uint32_t size;
+    uint32_t used;
+    uint32_t index;
+    uint32_t count;
+    uint8_t res;
+
+    /* ljson_contex_parse_parallel */
+    ljson_parser_t parser;
+    const char *text;       /* the items, ',' between them */
+    uint32_t length;
+} ljson_part_t;
+
+/* separators of an array found by ljson_index_array, offsets from its '[' */
+typedef struct _ljson_index
+{
+    uint32_t *offset;       /* '[' then the ',' before every stride-th item */
+    uint32_t size;
+    uint32_t count;         /* offsets kept */
+    uint32_t stride;        /* items from one offset to the next, doubled each time offset fills */
+    uint32_t items;
+    uint32_t end;           /* the ']' */
+} ljson_index_t;
+
+struct _ljson_batch;
+
+/* records of a batch bound, slots reused after return, on any thread (one at a time with LJSON_NDJSON_ORDER) */
+typedef uint8_t(*ljson_deliver_t)(struct _ljson_batch *batch, void *user);
+
+/* line at offset of the input not bound, res from the parser, on any thread */
+typedef void(*ljson_skip_t)(void *user, uint32_t offset, uint8_t res);
+
+/* records bound by one job of ljson_ndjson_parse */
+typedef struct _ljson_batch
+{
+    ljson_parser_t parser;
+    ljson_contex_t contex;  /* as set by the caller (arena, track...), copied for each line with base at its record */
+    ljson_contex_t bind;
+    uint8_t *record;        /* room slots of size bytes, zeroed before binding */
+    uint32_t size;
+    uint32_t room;
+    uint32_t count;         /* records ready */
+    uint32_t skip;          /* lines not bound */
+    uint8_t res;
+} ljson_batch_t;
+
+typedef struct _ljson_ndjson
+{
+    ljson_pool_t *pool;
+    ljson_batch_t *batch;
+    uint16_t count;
+    uint8_t flag;           /* LJSON_NDJSON_ORDER */
+    ljson_deliver_t deliver;
+    ljson_skip_t skip;      /* 0: lines only counted */
+    void *user;
+    pthread_mutex_t mutex;
+    pthread_cond_t turn;    /* a chunk delivered */
+
+    /* ljson_ndjson_parse */
+    const char *buffer;
+    uint32_t length;        /* whole lines */
+    uint32_t next;          /* first byte not yet taken */
+    uint32_t chunk_next;    /* chunks taken */
+    uint32_t chunk_turn;    /* chunks delivered, LJSON_NDJSON_ORDER */
+    uint8_t stop;
+    uint32_t used;          /* bytes of the last ljson_ndjson_parse consumed, the tail after its last '\n' left */
+} ljson_ndjson_t;
+
+////////////////////////////////////////
+
+uint8_t ljson_pool_init(ljson_pool_t *pool);
+void ljson_pool_exit(ljson_pool_t *pool);
+void ljson_pool_run(ljson_pool_t *pool, ljson_job_t job, void *user, uint16_t count);
+
+////////////////////////////////////////
+
+uint8_t ljson_contex_write_parallel(ljson_contex_t *contex, ljson_writer_t *writer, ljson_pool_t *pool, uint16_t item,
+    ljson_part_t *part, uint16_t count, char *buffer, uint32_t size);
+
+////////////////////////////////////////
+
+void ljson_index_init(ljson_index_t *index, uint32_t *offset, uint32_t size);
+uint8_t ljson_index_array(ljson_index_t *index, const void *buffer, uint32_t length);
+uint8_t ljson_contex_parse_parallel(ljson_contex_t *contex, ljson_pool_t *pool, uint16_t item, ljson_part_t *part, uint16_t count,
+    ljson_index_t *index, const void *buffer, uint32_t length);
+
+////////////////////////////////////////
+
+void ljson_batch_init(ljson_batch_t *batch, const ljson_schema_t *schema, void *record, uint32_t size, uint32_t room);
+void ljson_ndjson_init(ljson_ndjson_t *ndjson, ljson_pool_t *pool, ljson_batch_t *batch, uint16_t count, uint8_t flag,
+    ljson_deliver_t deliver, ljson_skip_t skip, void *user);
+void ljson_ndjson_exit(ljson_ndjson_t *ndjson);
+uint8_t ljson_ndjson_parse(ljson_ndjson_t *ndjson, const void *buffer, uint32_t length, uint8_t flag);
+
+////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !_LJSON_THREAD_H_
@@ -0,0 +1,962 @@
+#include "ljson_zlib.h"
+#include <string.h> /* memset */
+
+#define LJSON_INFLATE_HEAD      0x00    /* zlib or gzip header */
+#define LJSON_INFLATE_GZIP      0x01    /* gzip fields by flag */
+#define LJSON_INFLATE_SKIP      0x02    /* length bytes, then after */
+#define LJSON_INFLATE_ZERO      0x03    /* bytes up to a '\0' */
+#define LJSON_INFLATE_BLOCK     0x04    /* block header */
+#define LJSON_INFLATE_STORED    0x05    /* LEN NLEN */
+#define LJSON_INFLATE_COPY      0x06    /* length stored bytes */
+#define LJSON_INFLATE_TABLE     0x07    /* HLIT HDIST HCLEN */
+#define LJSON_INFLATE_CODES     0x08    /* code lengths of the code length code */
+#define LJSON_INFLATE_LENS      0x09    /* code lengths */
+#define LJSON_INFLATE_REPEAT    0x0A    /* extra bits of a repeated code length */
+#define LJSON_INFLATE_SYMBOL    0x0B    /* literal, length or end of block */
+#define LJSON_INFLATE_LENGTH    0x0C    /* extra bits of a length */
+#define LJSON_INFLATE_DIST      0x0D    /* distance */
+#define LJSON_INFLATE_DISTEXT   0x0E    /* extra bits of a distance, then the match */
+#define LJSON_INFLATE_CHECK     0x0F    /* trailer */
+#define LJSON_INFLATE_DONE      0x10
+
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef LJSON_ZLIB
+
+static int _ljson_zlib_bits(uint8_t format)
+{
+    switch (format)
+    {
+    case LJSON_ZLIB_RAW:
+        return -MAX_WBITS;
+    case LJSON_ZLIB_GZIP:
+        return MAX_WBITS + 16;
+    case LJSON_ZLIB_AUTO:
+        return MAX_WBITS + 32;
+    default:
+        return MAX_WBITS;
+    }
+}
+
+uint8_t ljson_inflate_init(ljson_inflate_t *inflater, uint8_t format, ljson_flush_t flush, void *user)
+{
+    memset(inflater, 0, sizeof(ljson_inflate_t));
+
+    inflater->format = format;
+    inflater->flush = flush;
+    inflater->user = user;
+    if (inflateInit2(&inflater->stream, _ljson_zlib_bits(format)) != Z_OK)
+    {
+        inflater->state = LJSON_INFLATE_DONE;
+        return LJSON_ERROR_ZLIB;
+    }
+
+    return LJSON_ERROR_NONE;
+}
+
+/* LJSON_ERROR_MORE until the end of the stream, then the last result of flush */
+uint8_t ljson_inflate_feed(ljson_inflate_t *inflater, const void *buffer, uint32_t length)
+{
+    z_stream *stream = &inflater->stream;
+    uint16_t size;
+    uint8_t res = LJSON_ERROR_NONE;
+    int ret;
+
+    if (inflater->state == LJSON_INFLATE_DONE)
+    {
+        inflater->used = 0;
+        return inflater->res;
+    }
+    stream->next_in = (Bytef *)buffer;
+    stream->avail_in = length;
+    do
+    {
+        stream->next_out = inflater->buffer;
+        stream->avail_out = sizeof(inflater->buffer);
+        ret = inflate(stream, Z_NO_FLUSH);
+        if ((ret != Z_OK) && (ret != Z_STREAM_END) && (ret != Z_BUF_ERROR))
+        {
+            res = LJSON_ERROR_ZLIB;
+            break;
+        }
+        size = (uint16_t)(sizeof(inflater->buffer) - stream->avail_out);
+        if (size > 0)
+        {
+            inflater->res = inflater->flush(inflater->buffer, size, inflater->user);
+            if ((inflater->res != LJSON_ERROR_NONE) && (inflater->res != LJSON_ERROR_MORE))
+            {
+                res = inflater->res;
+                break;
+            }
+        }
+        if (ret == Z_STREAM_END)
+        {
+            inflater->state = LJSON_INFLATE_DONE;
+            break;
+        }
+    } while (stream->avail_out == 0);
+    inflater->used = length - stream->avail_in;
+    if (res != LJSON_ERROR_NONE)
+    {
+        return res;
+    }
+
+    return (inflater->state == LJSON_INFLATE_DONE) ? inflater->res : LJSON_ERROR_MORE;
+}
+
+void ljson_inflate_exit(ljson_inflate_t *inflater)
+{
+    inflateEnd(&inflater->stream);
+}
+
+////////////////////////////////////////
+
+uint8_t ljson_deflate_init(ljson_deflate_t *deflater, uint8_t format, int8_t level, ljson_flush_t flush, void *user)
+{
+    memset(deflater, 0, sizeof(ljson_deflate_t));
+
+    deflater->format = format;
+    deflater->flush = flush;
+    deflater->user = user;
+    if (deflateInit2(&deflater->stream, level, Z_DEFLATED, _ljson_zlib_bits(format), 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        deflater->error = LJSON_ERROR_ZLIB;
+    }
+
+    return deflater->error;
+}
+
+/* what zlib made of the input so far, to flush */
+static uint8_t _ljson_deflate_run(ljson_deflate_t *deflater, const void *buffer, uint16_t length, int mode)
+{
+    z_stream *stream = &deflater->stream;
+    uint16_t size;
+    int ret;
+
+    stream->next_in = (Bytef *)buffer;
+    stream->avail_in = length;
+    while (deflater->error == LJSON_ERROR_NONE)
+    {
+        stream->next_out = deflater->buffer;
+        stream->avail_out = sizeof(deflater->buffer);
+        ret = deflate(stream, mode);
+        if (ret == Z_STREAM_ERROR)
+        {
+            deflater->error = LJSON_ERROR_ZLIB;
+            break;
+        }
+        size = (uint16_t)(sizeof(deflater->buffer) - stream->avail_out);
+        if (size > 0)
+        {
+            deflater->error = deflater->flush(deflater->buffer, size, deflater->user);
+        }
+        if ((ret == Z_STREAM_END) || ((mode != Z_FINISH) && (stream->avail_out > 0)))
+        {
+            break;
+        }
+    }
+
+    return deflater->error;
+}
+
+/* ljson_flush_t of a writer, user is the ljson_deflate_t */
+uint8_t ljson_deflate_flush(const void *buffer, uint16_t length, void *user)
+{
+    return _ljson_deflate_run((ljson_deflate_t *)user, buffer, length, Z_NO_FLUSH);
+}
+
+/* after the writer is flushed, the rest of the stream out */
+uint8_t ljson_deflate_end(ljson_deflate_t *deflater)
+{
+    _ljson_deflate_run(deflater, 0, 0, Z_FINISH);
+    deflateEnd(&deflater->stream);
+
+    return deflater->error;
+}
+
+#else
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const uint16_t _ljson_length_base[29] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t _ljson_length_extra[29] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t _ljson_dist_base[30] =
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+    4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t _ljson_dist_extra[30] =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const uint8_t _ljson_code_order[19] =
+{
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+/* CRC-32 a nibble at a time */
+static const uint32_t _ljson_crc_table[16] =
+{
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static uint32_t _ljson_crc32(uint32_t crc, const uint8_t *buffer, uint32_t length)
+{
+    crc = ~crc;
+    while (length-- > 0)
+    {
+        crc ^= *buffer++;
+        crc = (crc >> 4) ^ _ljson_crc_table[crc & 0x0F];
+        crc = (crc >> 4) ^ _ljson_crc_table[crc & 0x0F];
+    }
+
+    return ~crc;
+}
+
+static uint32_t _ljson_adler32(uint32_t adler, const uint8_t *buffer, uint32_t length)
+{
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    uint32_t size;
+
+    while (length > 0)
+    {
+        /* no overflow before the modulo */
+        size = (length < 5552) ? length : 5552;
+        length -= size;
+        while (size-- > 0)
+        {
+            a += *buffer++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+
+    return (b << 16) | a;
+}
+
+/* check of the format over more text */
+static uint32_t _ljson_zlib_check(uint8_t format, uint32_t check, const uint8_t *buffer, uint32_t length)
+{
+    switch (format)
+    {
+    case LJSON_ZLIB_GZIP:
+        return _ljson_crc32(check, buffer, length);
+    case LJSON_ZLIB_ZLIB:
+        return _ljson_adler32(check, buffer, length);
+    default:
+        return check;
+    }
+}
+
+////////////////////////////////////////
+
+/* canonical code of n symbols from their lengths, 0 if over-subscribed */
+static uint8_t _ljson_huffman_build(ljson_huffman_t *huffman, const uint8_t *length, uint16_t n)
+{
+    uint16_t offset[16];
+    int32_t left = 1;
+    uint16_t symbol;
+    uint16_t code;
+    uint16_t index;
+    uint16_t reverse;
+    uint8_t bit;
+    uint8_t i;
+
+    memset(huffman->count, 0, sizeof(huffman->count));
+    for (symbol = 0; symbol < n; symbol++)
+    {
+        huffman->count[length[symbol]]++;
+    }
+    for (i = 1; i < 16; i++)
+    {
+        left = (left << 1) - huffman->count[i];
+        if (left < 0)
+        {
+            return 0;
+        }
+    }
+    offset[1] = 0;
+    for (i = 1; i < 15; i++)
+    {
+        offset[i + 1] = offset[i] + huffman->count[i];
+    }
+    for (symbol = 0; symbol < n; symbol++)
+    {
+        if (length[symbol] != 0)
+        {
+            huffman->symbol[offset[length[symbol]]++] = symbol;
+        }
+    }
+
+    /* short codes, bit reversed as they come */
+    memset(huffman->fast, 0, sizeof(huffman->fast));
+    code = 0;
+    index = 0;
+    for (i = 1; i <= LJSON_HUFFMAN_FAST; i++)
+    {
+        for (symbol = 0; symbol < huffman->count[i]; symbol++, code++, index++)
+        {
+            for (reverse = 0, bit = 0; bit < i; bit++)
+            {
+                reverse |= ((code >> bit) & 1) << (i - 1 - bit);
+            }
+            for (; reverse < (1 << LJSON_HUFFMAN_FAST); reverse += (uint16_t)(1 << i))
+            {
+                huffman->fast[reverse] = (uint16_t)((huffman->symbol[index] << 4) | i);
+            }
+        }
+        code <<= 1;
+    }
+
+    return 1;
+}
+
+/* n bits in hand, 0 if the input ran out first */
+static uint8_t _ljson_inflate_need(ljson_inflate_t *inflater, uint8_t n)
+{
+    while (inflater->count < n)
+    {
+        if (inflater->next >= inflater->end)
+        {
+            return 0;
+        }
+        inflater->bits |= (uint64_t)(*inflater->next++) << inflater->count;
+        inflater->count += 8;
+    }
+
+    return 1;
+}
+
+static uint32_t _ljson_inflate_bits(ljson_inflate_t *inflater, uint8_t n)
+{
+    uint32_t value = (uint32_t)(inflater->bits & (((uint64_t)1 << n) - 1));
+
+    inflater->bits >>= n;
+    inflater->count -= n;
+
+    return value;
+}
+
+/* next symbol of huffman into symbol (0xFFFF: no such code), 0 if the input ran out first */
+static uint8_t _ljson_inflate_decode(ljson_inflate_t *inflater, const ljson_huffman_t *huffman, uint16_t *symbol)
+{
+    int32_t code = 0;
+    int32_t first = 0;
+    int32_t index = 0;
+    uint16_t fast;
+    uint8_t i;
+
+    if (_ljson_inflate_need(inflater, LJSON_HUFFMAN_FAST))
+    {
+        fast = huffman->fast[inflater->bits & ((1 << LJSON_HUFFMAN_FAST) - 1)];
+        if (fast != 0)
+        {
+            _ljson_inflate_bits(inflater, fast & 0x0F);
+            *symbol = fast >> 4;
+            return 1;
+        }
+    }
+    /* a longer code, or the end of the input near */
+    for (i = 1; i < 16; i++)
+    {
+        if (!_ljson_inflate_need(inflater, i))
+        {
+            return 0;
+        }
+        code |= (int32_t)(inflater->bits >> (i - 1)) & 1;
+        if (code - first < huffman->count[i])
+        {
+            _ljson_inflate_bits(inflater, i);
+            *symbol = huffman->symbol[index + code - first];
+            return 1;
+        }
+        index += huffman->count[i];
+        first = (first + huffman->count[i]) << 1;
+        code <<= 1;
+    }
+    *symbol = 0xFFFF;
+
+    return 1;
+}
+
+/* text of window not handed out yet to flush */
+static uint8_t _ljson_inflate_out(ljson_inflate_t *inflater)
+{
+    uint16_t size = inflater->window_used - inflater->window_flush;
+
+    if (size > 0)
+    {
+        inflater->check = _ljson_zlib_check(inflater->format, inflater->check, inflater->window + inflater->window_flush, size);
+        inflater->res = inflater->flush(inflater->window + inflater->window_flush, size, inflater->user);
+        if ((inflater->res != LJSON_ERROR_NONE) && (inflater->res != LJSON_ERROR_MORE))
+        {
+            return inflater->res;
+        }
+    }
+    inflater->window_flush = inflater->window_used;
+    if (inflater->window_used == LJSON_ZLIB_WINDOW)
+    {
+        /* the history stays for matches */
+        inflater->window_used = 0;
+        inflater->window_flush = 0;
+    }
+
+    return LJSON_ERROR_NONE;
+}
+
+static uint8_t _ljson_inflate_put(ljson_inflate_t *inflater, uint8_t ch)
+{
+    inflater->window[inflater->window_used++] = ch;
+    inflater->total++;
+
+    return (inflater->window_used == LJSON_ZLIB_WINDOW) ? _ljson_inflate_out(inflater) : LJSON_ERROR_NONE;
+}
+
+/* codes of a fixed huffman block */
+static void _ljson_inflate_fixed(ljson_inflate_t *inflater)
+{
+    uint16_t i;
+
+    for (i = 0; i < 288; i++)
+    {
+        inflater->lengths[i] = (i < 144) ? 8 : ((i < 256) ? 9 : ((i < 280) ? 7 : 8));
+    }
+    _ljson_huffman_build(&inflater->lencode, inflater->lengths, 288);
+    for (i = 0; i < 30; i++)
+    {
+        inflater->lengths[i] = 5;
+    }
+    _ljson_huffman_build(&inflater->distcode, inflater->lengths, 30);
+}
+
+/* header of the stream, zlib or gzip */
+static uint8_t _ljson_inflate_head(ljson_inflate_t *inflater)
+{
+    uint8_t cmf;
+    uint8_t flg;
+
+    if (inflater->format == LJSON_ZLIB_RAW)
+    {
+        inflater->state = LJSON_INFLATE_BLOCK;
+        return LJSON_ERROR_NONE;
+    }
+    /* what comes after a zlib header is 4 bytes at least */
+    if (!_ljson_inflate_need(inflater, 32))
+    {
+        return LJSON_ERROR_MORE;
+    }
+    if ((inflater->format != LJSON_ZLIB_ZLIB) && ((inflater->bits & 0xFFFF) == 0x8B1F))
+    {
+        /* ID1 ID2 CM FLG, then MTIME XFL OS */
+        if (((inflater->bits >> 16) & 0xFF) != 8)
+        {
+            return LJSON_ERROR_ZLIB;
+        }
+        inflater->format = LJSON_ZLIB_GZIP;
+        inflater->flag = (uint8_t)(inflater->bits >> 24);
+        _ljson_inflate_bits(inflater, 32);
+        inflater->check = 0;
+        inflater->length = 6;
+        inflater->after = LJSON_INFLATE_GZIP;
+        inflater->state = LJSON_INFLATE_SKIP;
+        return LJSON_ERROR_NONE;
+    }
+    if (inflater->format == LJSON_ZLIB_GZIP)
+    {
+        return LJSON_ERROR_ZLIB;
+    }
+    cmf = (uint8_t)inflater->bits;
+    flg = (uint8_t)(inflater->bits >> 8);
+    if (((cmf & 0x0F) != 8) || ((cmf >> 4) > 7) || ((((uint16_t)cmf << 8) | flg) % 31 != 0) || (flg & 0x20))
+    {
+        /* preset dictionaries neither */
+        return LJSON_ERROR_ZLIB;
+    }
+    inflater->format = LJSON_ZLIB_ZLIB;
+    _ljson_inflate_bits(inflater, 16);
+    inflater->check = 1;
+    inflater->state = LJSON_INFLATE_BLOCK;
+
+    return LJSON_ERROR_NONE;
+}
+
+/* one step of the stream, LJSON_ERROR_MORE when the input ran out */
+static uint8_t _ljson_inflate_step(ljson_inflate_t *inflater)
+{
+    uint16_t symbol;
+    uint16_t distance;
+    uint16_t length;
+    uint8_t value;
+    uint8_t res;
+
+    switch (inflater->state)
+    {
+    case LJSON_INFLATE_HEAD:
+        return _ljson_inflate_head(inflater);
+    case LJSON_INFLATE_GZIP:
+        if (inflater->flag & 0x04)
+        {
+            /* FEXTRA */
+            if (!_ljson_inflate_need(inflater, 16))
+            {
+                return LJSON_ERROR_MORE;
+            }
+            inflater->flag &= ~0x04;
+            inflater->length = (uint16_t)_ljson_inflate_bits(inflater, 16);
+            inflater->state = LJSON_INFLATE_SKIP;
+        }
+        else if (inflater->flag & 0x18)
+        {
+            /* FNAME, then FCOMMENT */
+            inflater->flag &= (inflater->flag & 0x08) ? ~0x08 : ~0x10;
+            inflater->state = LJSON_INFLATE_ZERO;
+        }
+        else if (inflater->flag & 0x02)
+        {
+            /* FHCRC */
+            inflater->flag &= ~0x02;
+            inflater->length = 2;
+            inflater->state = LJSON_INFLATE_SKIP;
+        }
+        else
+        {
+            inflater->state = LJSON_INFLATE_BLOCK;
+        }
+        inflater->after = LJSON_INFLATE_GZIP;
+        break;
+    case LJSON_INFLATE_SKIP:
+        while (inflater->length > 0)
+        {
+            if (!_ljson_inflate_need(inflater, 8))
+            {
+                return LJSON_ERROR_MORE;
+            }
+            _ljson_inflate_bits(inflater, 8);
+            inflater->length--;
+        }
+        inflater->state = inflater->after;
+        break;
+    case LJSON_INFLATE_ZERO:
+        do
+        {
+            if (!_ljson_inflate_need(inflater, 8))
+            {
+                return LJSON_ERROR_MORE;
+            }
+        } while (_ljson_inflate_bits(inflater, 8) != 0);
+        inflater->state = LJSON_INFLATE_GZIP;
+        break;
+    case LJSON_INFLATE_BLOCK:
+        if (inflater->last)
+        {
+            inflater->state = LJSON_INFLATE_CHECK;
+            /* byte aligned */
+            _ljson_inflate_bits(inflater, inflater->count & 7);
+            return _ljson_inflate_out(inflater);
+        }
+        if (!_ljson_inflate_need(inflater, 3))
+        {
+            return LJSON_ERROR_MORE;
+        }
+        inflater->last = (uint8_t)_ljson_inflate_bits(inflater, 1);
+        switch (_ljson_inflate_bits(inflater, 2))
+        {
+        case 0:
+            _ljson_inflate_bits(inflater, inflater->count & 7);
+            inflater->state = LJSON_INFLATE_STORED;
+            break;
+        case 1:
+            _ljson_inflate_fixed(inflater);
+            inflater->state = LJSON_INFLATE_SYMBOL;
+            break;
+        case 2:
+            inflater->state = LJSON_INFLATE_TABLE;
+            break;
+        default:
+            return LJSON_ERROR_ZLIB;
+        }
+        break;
+    case LJSON_INFLATE_STORED:
+        if (!_ljson_inflate_need(inflater, 32))
+        {
+            return LJSON_ERROR_MORE;
+        }
+        inflater->length = (uint16_t)_ljson_inflate_bits(inflater, 16);
+        if (inflater->length != (uint16_t)~_ljson_inflate_bits(inflater, 16))
+        {
+            return LJSON_ERROR_ZLIB;
+        }
+        inflater->state = LJSON_INFLATE_COPY;
+        break;
+    case LJSON_INFLATE_COPY:
+        while (inflater->length > 0)
+        {
+            if (inflater->count >= 8)
+            {
+                value = (uint8_t)_ljson_inflate_bits(inflater, 8);
+            }
+            else if (inflater->next < inflater->end)
+            {
+                value = *inflater->next++;
+            }
+            else
+            {
+                return LJSON_ERROR_MORE;
+            }
+            inflater->length--;
+            res = _ljson_inflate_put(inflater, value);
+            if (res != LJSON_ERROR_NONE)
+            {
+                return res;
+            }
+        }
+        inflater->state = LJSON_INFLATE_BLOCK;
+        break;
+    case LJSON_INFLATE_TABLE:
+        if (!_ljson_inflate_need(inflater, 14))
+        {
+            return LJSON_ERROR_MORE;
+        }
+        inflater->lens = (uint16_t)_ljson_inflate_bits(inflater, 5) + 257;
+        inflater->dists = (uint16_t)_ljson_inflate_bits(inflater, 5) + 1;
+        inflater->codes = (uint16_t)_ljson_inflate_bits(inflater, 4) + 4;
+        if ((inflater->lens > 286) || (inflater->dists > 30))
+        {
+            return LJSON_ERROR_ZLIB;
+        }
+        inflater->index = 0;
+        inflater->state = LJSON_INFLATE_CODES;
+        break;
+    case LJSON_INFLATE_CODES:
+        while (inflater->index < inflater->codes)
+        {
+            if (!_ljson_inflate_need(inflater, 3))
+            {
+                return LJSON_ERROR_MORE;
+            }
+            inflater->lengths[_ljson_code_order[inflater->index++]] = (uint8_t)_ljson_inflate_bits(inflater, 3);
+        }
+        while (inflater->index < 19)
+        {
+            inflater->lengths[_ljson_code_order[inflater->index++]] = 0;
+        }
+        /* lencode holds the code length code until the lengths are read */
+        if (!_ljson_huffman_build(&inflater->lencode, inflater->lengths, 19))
+        {
+            return LJSON_ERROR_ZLIB;
+        }
+        inflater->index = 0;
+        inflater->state = LJSON_INFLATE_LENS;
+        break;
+    case LJSON_INFLATE_LENS:
+        while (inflater->index < inflater->lens + inflater->dists)
+        {
+            if (!_ljson_inflate_decode(inflater, &inflater->lencode, &symbol))
+            {
+                return LJSON_ERROR_MORE;
+            }
+            if (symbol >= 19)
+            {
+                return LJSON_ERROR_ZLIB;
+            }
+            if (symbol >= 16)
+            {
+                inflater->symbol = symbol;
+                inflater->state = LJSON_INFLATE_REPEAT;
+                return LJSON_ERROR_NONE;
+            }
+            inflater->lengths[inflater->index++] = (uint8_t)symbol;
+        }
+        if ((inflater->lengths[256] == 0)
+            || !_ljson_huffman_build(&inflater->lencode, inflater->lengths, inflater->lens)
+            || !_ljson_huffman_build(&inflater->distcode, inflater->lengths + inflater->lens, inflater->dists))
+        {
+            return LJSON_ERROR_ZLIB;
+        }
+        inflater->state = LJSON_INFLATE_SYMBOL;
+        break;
+    case LJSON_INFLATE_REPEAT:
+        /* 16: the last 3 to 6 times, 17: 0 3 to 10 times, 18: 0 11 to 138 times */
+        value = (inflater->symbol == 16) ? 2 : ((inflater->symbol == 17) ? 3 : 7);
+        if (!_ljson_inflate_need(inflater, value))
+        {
+            return LJSON_ERROR_MORE;
+        }
+        length = (uint16_t)_ljson_inflate_bits(inflater, value) + ((inflater->symbol == 18) ? 11 : 3);
+        if ((inflater->symbol == 16) && (inflater->index == 0))
+        {
+            return LJSON_ERROR_ZLIB;
+        }
+        value = (inflater->symbol == 16) ? inflater->lengths[inflater->index - 1] : 0;
+        if (inflater->index + length > inflater->lens + inflater->dists)
+        {
+            return LJSON_ERROR_ZLIB;
+        }
+        while (length-- > 0)
+        {
+            inflater->lengths[inflater->index++] = value;
+        }
+        inflater->state = LJSON_INFLATE_LENS;
+        break;
+    case LJSON_INFLATE_SYMBOL:
+        while (1)
+        {
+            if (!_ljson_inflate_decode(inflater, &inflater->lencode, &symbol))
+            {
+                return LJSON_ERROR_MORE;
+            }
+            if (symbol >= 256)
+            {
+                break;
+            }
+            res = _ljson_inflate_put(inflater, (uint8_t)symbol);
+            if (res != LJSON_ERROR_NONE)
+            {
+                return res;
+            }
+        }
+        if (symbol == 256)
+        {
+            inflater->state = LJSON_INFLATE_BLOCK;
+            break;
+        }
+        symbol -= 257;
+        if (symbol >= 29)
+        {
+            return LJSON_ERROR_ZLIB;
+        }
+        inflater->symbol = symbol;
+        inflater->state = LJSON_INFLATE_LENGTH;
+        break;
+    case LJSON_INFLATE_LENGTH:
+        if (!_ljson_inflate_need(inflater, _ljson_length_extra[inflater->symbol]))
+        {
+            return LJSON_ERROR_MORE;
+        }
+        inflater->length = _ljson_length_base[inflater->symbol] + (uint16_t)_ljson_inflate_bits(inflater, _ljson_length_extra[inflater->symbol]);
+        inflater->state = LJSON_INFLATE_DIST;
+        break;
+    case LJSON_INFLATE_DIST:
+        if (!_ljson_inflate_decode(inflater, &inflater->distcode, &symbol))
+        {
+            return LJSON_ERROR_MORE;
+        }
+        if (symbol >= 30)
+        {
+            return LJSON_ERROR_ZLIB;
+        }
+        inflater->symbol = symbol;
+        inflater->state = LJSON_INFLATE_DISTEXT;
+        break;
+    case LJSON_INFLATE_DISTEXT:
+        if (!_ljson_inflate_need(inflater, _ljson_dist_extra[inflater->symbol]))
+        {
+            return LJSON_ERROR_MORE;
+        }
+        distance = _ljson_dist_base[inflater->symbol] + (uint16_t)_ljson_inflate_bits(inflater, _ljson_dist_extra[inflater->symbol]);
+        if (distance > inflater->total)
+        {
+            return LJSON_ERROR_ZLIB;
+        }
+        while (inflater->length > 0)
+        {
+            inflater->length--;
+            res = _ljson_inflate_put(inflater, inflater->window[(inflater->window_used - distance) & (LJSON_ZLIB_WINDOW - 1)]);
+            if (res != LJSON_ERROR_NONE)
+            {
+                return res;
+            }
+        }
+        inflater->state = LJSON_INFLATE_SYMBOL;
+        break;
+    case LJSON_INFLATE_CHECK:
+        if (inflater->format == LJSON_ZLIB_RAW)
+        {
+            inflater->state = LJSON_INFLATE_DONE;
+            break;
+        }
+        if (inflater->format == LJSON_ZLIB_ZLIB)
+        {
+            /* Adler-32 big-endian */
+            if (!_ljson_inflate_need(inflater, 32))
+            {
+                return LJSON_ERROR_MORE;
+            }
+            for (length = 0; length < 4; length++)
+            {
+                distance = (uint16_t)_ljson_inflate_bits(inflater, 8);
+                if (distance != ((inflater->check >> (24 - 8 * length)) & 0xFF))
+                {
+                    return LJSON_ERROR_ZLIB;
+                }
+            }
+            inflater->state = LJSON_INFLATE_DONE;
+            break;
+        }
+        /* CRC32 ISIZE */
+        if (!_ljson_inflate_need(inflater, 64))
+        {
+            return LJSON_ERROR_MORE;
+        }
+        if ((_ljson_inflate_bits(inflater, 32) != inflater->check) || (_ljson_inflate_bits(inflater, 32) != inflater->total))
+        {
+            return LJSON_ERROR_ZLIB;
+        }
+        inflater->state = LJSON_INFLATE_DONE;
+        break;
+    default:
+        return LJSON_ERROR_ZLIB;
+    }
+
+    return LJSON_ERROR_NONE;
+}
+
+uint8_t ljson_inflate_init(ljson_inflate_t *inflater, uint8_t format, ljson_flush_t flush, void *user)
+{
+    /* not the window */
+    memset(inflater, 0, offsetof(ljson_inflate_t, window));
+
+    inflater->format = format;
+    inflater->state = LJSON_INFLATE_HEAD;
+    inflater->flush = flush;
+    inflater->user = user;
+
+    return LJSON_ERROR_NONE;
+}
+
+/* LJSON_ERROR_MORE until the end of the stream, then the last result of flush */
+uint8_t ljson_inflate_feed(ljson_inflate_t *inflater, const void *buffer, uint32_t length)
+{
+    uint8_t res = LJSON_ERROR_NONE;
+
+    inflater->next = (const uint8_t *)buffer;
+    inflater->end = inflater->next + length;
+    while ((inflater->state != LJSON_INFLATE_DONE) && (res == LJSON_ERROR_NONE))
+    {
+        res = _ljson_inflate_step(inflater);
+    }
+    if (res == LJSON_ERROR_MORE)
+    {
+        /* what there is so far */
+        res = _ljson_inflate_out(inflater);
+    }
+    inflater->used = (uint32_t)(inflater->next - (const uint8_t *)buffer);
+    if (res != LJSON_ERROR_NONE)
+    {
+        return res;
+    }
+
+    return (inflater->state == LJSON_INFLATE_DONE) ? inflater->res : LJSON_ERROR_MORE;
+}
+
+void ljson_inflate_exit(ljson_inflate_t *inflater)
+{
+    inflater->state = LJSON_INFLATE_DONE;
+}
+
+////////////////////////////////////////
+
+/* header of the format, level is for zlib only */
+uint8_t ljson_deflate_init(ljson_deflate_t *deflater, uint8_t format, int8_t level, ljson_flush_t flush, void *user)
+{
+    static const uint8_t gzip[10] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF };
+    static const uint8_t zlib[2] = { 0x78, 0x01 };
+
+    (void)level;
+    memset(deflater, 0, sizeof(ljson_deflate_t));
+
+    deflater->format = format;
+    deflater->flush = flush;
+    deflater->user = user;
+    switch (format)
+    {
+    case LJSON_ZLIB_GZIP:
+        deflater->error = flush(gzip, sizeof(gzip), user);
+        break;
+    case LJSON_ZLIB_ZLIB:
+        deflater->check = 1;
+        deflater->error = flush(zlib, sizeof(zlib), user);
+        break;
+    case LJSON_ZLIB_RAW:
+        break;
+    default:
+        deflater->error = LJSON_ERROR_ZLIB;
+        break;
+    }
+
+    return deflater->error;
+}
+
+/* ljson_flush_t of a writer, user is the ljson_deflate_t: each block a stored block, text as it is */
+uint8_t ljson_deflate_flush(const void *buffer, uint16_t length, void *user)
+{
+    ljson_deflate_t *deflater = (ljson_deflate_t *)user;
+    uint8_t head[5];
+
+    if ((deflater->error != LJSON_ERROR_NONE) || (length == 0))
+    {
+        return deflater->error;
+    }
+    /* BFINAL 0, BTYPE 00, LEN NLEN */
+    head[0] = 0;
+    head[1] = (uint8_t)length;
+    head[2] = (uint8_t)(length >> 8);
+    head[3] = (uint8_t)~head[1];
+    head[4] = (uint8_t)~head[2];
+    deflater->check = _ljson_zlib_check(deflater->format, deflater->check, (const uint8_t *)buffer, length);
+    deflater->total += length;
+    deflater->error = deflater->flush(head, sizeof(head), deflater->user);
+    if (deflater->error == LJSON_ERROR_NONE)
+    {
+        deflater->error = deflater->flush(buffer, length, deflater->user);
+    }
+
+    return deflater->error;
+}
+
+/* after the writer is flushed, an empty last block and the trailer */
+uint8_t ljson_deflate_end(ljson_deflate_t *deflater)
+{
+    uint8_t tail[13] = { 1, 0, 0, 0xFF, 0xFF };
+    uint8_t length = 5;
+    uint8_t i;
+
+    if (deflater->error != LJSON_ERROR_NONE)
+    {
+        return deflater->error;
+    }
+    switch (deflater->format)
+    {
+    case LJSON_ZLIB_GZIP:
+        for (i = 0; i < 4; i++)
+        {
+            tail[length + i] = (uint8_t)(deflater->check >> (8 * i));
+            tail[length + 4 + i] = (uint8_t)(deflater->total >> (8 * i));
+        }
+        length += 8;
+        break;
+    case LJSON_ZLIB_ZLIB:
+        for (i = 0; i < 4; i++)
+        {
+            tail[length + i] = (uint8_t)(deflater->check >> (24 - 8 * i));
+        }
+        length += 4;
+        break;
+    default:
+        break;
+    }
+    deflater->error = deflater->flush(tail, length, deflater->user);
+
+    return deflater->error;
+}
+
+#endif
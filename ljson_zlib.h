@@ -0,0 +1,109 @@
+#ifndef _LJSON_ZLIB_H_
+#define _LJSON_ZLIB_H_
+
+#include "ljson.h"
+
+/* #define LJSON_ZLIB */                /* system zlib (-lz), else the bundled inflater and stored blocks out */
+
+#ifdef LJSON_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LJSON_ZLIB_CHUNK        4096    /* bytes handed to the sink at once through zlib */
+#define LJSON_ZLIB_WINDOW       32768   /* history of the bundled inflater, as deflate allows */
+#define LJSON_HUFFMAN_FAST      9       /* bits of a code looked up at once by the bundled inflater */
+
+#define LJSON_ZLIB_RAW          0x00    /* deflate, RFC 1951 */
+#define LJSON_ZLIB_ZLIB         0x01    /* RFC 1950 */
+#define LJSON_ZLIB_GZIP         0x02    /* RFC 1952 */
+#define LJSON_ZLIB_AUTO         0x03    /* zlib or gzip by the header, ljson_inflate_init only */
+
+////////////////////////////////////////
+
+typedef struct _ljson_huffman
+{
+    uint16_t count[16];     /* codes of each length */
+    uint16_t symbol[288];   /* by code */
+    uint16_t fast[1 << LJSON_HUFFMAN_FAST];    /* symbol << 4 | length by the next bits, 0: longer code */
+} ljson_huffman_t;
+
+/* compressed in, text out to flush in pieces as it comes */
+typedef struct _ljson_inflate
+{
+    uint8_t format;
+    uint8_t state;
+    uint32_t used;          /* bytes of the last ljson_inflate_feed consumed */
+    uint8_t res;            /* last result of flush, LJSON_ERROR_MORE included */
+
+    ljson_flush_t flush;
+    void *user;
+
+#ifdef LJSON_ZLIB
+    z_stream stream;
+    uint8_t buffer[LJSON_ZLIB_CHUNK];
+#else
+    const uint8_t *next;    /* input of the feed */
+    const uint8_t *end;
+    uint64_t bits;
+    uint8_t count;          /* bits in hand */
+    uint8_t last;           /* last block */
+    uint8_t flag;           /* gzip header flags left */
+    uint8_t after;          /* state after LJSON_INFLATE_SKIP */
+    uint16_t symbol;        /* decoded, its extra bits to come */
+    uint16_t length;        /* bytes left to copy or skip, length of a match */
+    uint16_t index;
+    uint16_t lens;          /* code lengths of the literal/length code */
+    uint16_t dists;
+    uint16_t codes;         /* code lengths of the code length code */
+    uint32_t check;         /* CRC-32 or Adler-32 of the text */
+    uint32_t total;         /* bytes of text */
+    uint16_t window_used;   /* next byte of window */
+    uint16_t window_flush;  /* text from here on not yet handed out */
+    ljson_huffman_t lencode;
+    ljson_huffman_t distcode;
+    uint8_t lengths[320];
+    uint8_t window[LJSON_ZLIB_WINDOW];
+#endif
+} ljson_inflate_t;
+
+/* text in through ljson_deflate_flush as the sink of a writer, compressed out to flush */
+typedef struct _ljson_deflate
+{
+    uint8_t format;
+    uint8_t error;          /* from flush or zlib, sticky */
+
+    ljson_flush_t flush;
+    void *user;
+
+#ifdef LJSON_ZLIB
+    z_stream stream;
+    uint8_t buffer[LJSON_ZLIB_CHUNK];
+#else
+    uint32_t check;
+    uint32_t total;
+#endif
+} ljson_deflate_t;
+
+////////////////////////////////////////
+
+uint8_t ljson_inflate_init(ljson_inflate_t *inflater, uint8_t format, ljson_flush_t flush, void *user);
+uint8_t ljson_inflate_feed(ljson_inflate_t *inflater, const void *buffer, uint32_t length);
+void ljson_inflate_exit(ljson_inflate_t *inflater);
+
+////////////////////////////////////////
+
+uint8_t ljson_deflate_init(ljson_deflate_t *deflater, uint8_t format, int8_t level, ljson_flush_t flush, void *user);
+uint8_t ljson_deflate_flush(const void *buffer, uint16_t length, void *user);
+uint8_t ljson_deflate_end(ljson_deflate_t *deflater);
+
+////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !_LJSON_ZLIB_H_